@@ -0,0 +1,30 @@
+HEADERS += \
+    $$PWD/include/mesh.hpp \
+    $$PWD/include/scenefile.hpp \
+    $$PWD/include/util.hpp \
+    $$PWD/include/mesh_iterators.hpp \
+    $$PWD/include/mesh_index.hpp \
+    $$PWD/include/mesh_decimator.hpp \
+    $$PWD/include/indexed_heap.hpp \
+    $$PWD/include/lazy_heap.hpp \
+    $$PWD/include/parallel.hpp \
+    $$PWD/include/quadric_batch.hpp \
+    $$PWD/include/decimation_stats.hpp \
+    $$PWD/include/memory_usage.hpp \
+    $$PWD/include/scene_decimator.hpp \
+    $$PWD/include/streaming_decimator.hpp \
+    $$PWD/include/vertex_clusterer.hpp
+
+SOURCES += \
+    $$PWD/src/scenefile.cpp \
+    $$PWD/src/mesh.cpp \
+    $$PWD/src/mesh_iterators.cpp \
+    $$PWD/src/util.cpp \
+    $$PWD/src/parallel.cpp \
+    $$PWD/src/quadric_batch.cpp \
+    $$PWD/src/decimation_stats.cpp \
+    $$PWD/src/memory_usage.cpp \
+    $$PWD/src/mesh_decimator.cpp \
+    $$PWD/src/scene_decimator.cpp \
+    $$PWD/src/streaming_decimator.cpp \
+    $$PWD/src/vertex_clusterer.cpp
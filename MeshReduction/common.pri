@@ -0,0 +1,42 @@
+CONFIG += debug_and_release
+
+INCLUDEPATH += $$PWD/include
+
+DEPENDPATH += $$PWD \
+    $$PWD/include \
+    $$PWD/src \
+    $$PWD/forms \
+    $$PWD/res \
+
+LIBS += -L$$PWD/lib
+
+CONFIGDIR = .
+
+CONFIG(release, debug|release):CONFIGDIR = ./release
+CONFIG(debug, debug|release):CONFIGDIR = ./debug
+
+CONFIG(debug, release|debug):DEFINES += _DEBUG
+
+OBJECTS_DIR = $$CONFIGDIR/.obj/$$TARGET
+MOC_DIR = $$CONFIGDIR/.moc/$$TARGET
+RCC_DIR = $$CONFIGDIR/.rcc
+UI_DIR = $$CONFIGDIR/.ui
+
+DESTDIR = $$CONFIGDIR/build
+
+msvc {
+    CONFIG(release, debug|release):LIBS += -lassimp
+    CONFIG(debug, debug|release):LIBS += -lassimpd
+}
+
+gcc:win32 {
+    LIBS += -lassimp.dll
+}
+
+win32 {
+    LIBS += -lpsapi # GetProcessMemoryInfo
+}
+
+gcc:!win32 {
+    LIBS += -lassimp
+}
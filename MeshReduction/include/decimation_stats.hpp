@@ -0,0 +1,68 @@
+#ifndef DECIMATION_STATS_HPP
+#define DECIMATION_STATS_HPP
+
+#include <cstddef>
+
+#include <QMetaType>
+#include <QJsonObject>
+#include <QString>
+
+/*!
+ * \brief measurements taken by MeshDecimator during a single run
+ */
+struct DecimationStats
+{
+    // wall clock time of the individual phases in milliseconds
+    double m_computeQuadricsMs;
+    double m_initPairsMs;
+    double m_initQueueMs;
+    double m_iterateMs;
+    double m_cleanupMs;
+    double m_normalsMs;
+
+    // time spent in priority queue operations during iterate() (only measured if m_queueTimed is set)
+    double m_queueMs;
+    bool m_queueTimed;
+
+    unsigned long long m_facesBefore, m_facesAfter, m_targetFaces;
+
+    unsigned long long m_collapses; // edge collapses performed
+    unsigned long long m_stalePairs; // popped pairs which had been merged or invalidated in the meantime
+    unsigned long long m_outdatedEntries; // entries of the lazy queue which were discarded because the pair had been updated
+
+    // popped pairs rejected by Mesh::checkPairContraction, by reason
+    unsigned long long m_rejectedTopology;
+    unsigned long long m_rejectedValency;
+    unsigned long long m_rejectedFaceFlip;
+
+    unsigned long long m_requeuedPairs; // rejected pairs which became contractable again and were re-added to the queue
+    unsigned long long m_retryRounds; // number of times the queue ran empty and the deferred pairs were re-examined
+
+    // heap allocations made by the collapse loop (only measured if m_allocationsCounted is set, see
+    // MeshDecimator::setAllocationCounter)
+    unsigned long long m_iterateAllocations;
+    bool m_allocationsCounted;
+
+    std::size_t m_peakMemoryBytes; // peak memory usage of the process (see peakMemoryUsage())
+
+    DecimationStats();
+
+    double totalMs() const;
+    unsigned long long rejections() const;
+
+    /*!
+     * \brief adds the measurements of another run. times and counts are summed up, peak memory is the maximum
+     */
+    DecimationStats& operator+=(const DecimationStats& other);
+
+    QJsonObject toJson() const;
+
+    /*!
+     * \brief short human readable summary (e.g. for a status bar)
+     */
+    QString summary() const;
+};
+
+Q_DECLARE_METATYPE(DecimationStats)
+
+#endif // DECIMATION_STATS_HPP
@@ -0,0 +1,199 @@
+#ifndef INDEXED_HEAP_HPP
+#define INDEXED_HEAP_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+/*!
+ * \brief value marking an index which is not contained in an indexed_heap
+ */
+const std::size_t inv_heap_pos(-1);
+
+/*!
+ * \brief contiguous d-ary min-heap of indices into some external array (e.g. vertex pairs), ordered by a key
+ *
+ * Keys are stored inside the heap entries, so comparisons never touch the external array. The heap position of
+ * every index is stored externally as well (usually next to the element itself) and is accessed through PositionMap,
+ * which must be a functor returning a std::size_t& for a given index. This allows updating and erasing arbitrary
+ * elements in logarithmic time.
+ */
+template<typename Key, typename PositionMap, unsigned int Arity = 4>
+class indexed_heap
+{
+    static_assert(Arity >= 2, "heap arity must be at least 2");
+
+public:
+    struct entry
+    {
+        Key m_key;
+        std::size_t m_index;
+    };
+
+private:
+    std::vector<entry> m_entries;
+    PositionMap m_positions;
+
+    static std::size_t parent(std::size_t i) { return (i - 1) / Arity; }
+    static std::size_t firstChild(std::size_t i) { return i * Arity + 1; }
+
+    void place(std::size_t i, const entry& e)
+    {
+        m_entries[i] = e;
+        m_positions(e.m_index) = i;
+    }
+
+    void siftUp(std::size_t i)
+    {
+        entry e = m_entries[i];
+
+        while (i > 0) {
+            std::size_t pi = parent(i);
+            if (!(e.m_key < m_entries[pi].m_key))
+                break;
+
+            place(i, m_entries[pi]);
+            i = pi;
+        }
+
+        place(i, e);
+    }
+
+    void siftDown(std::size_t i)
+    {
+        entry e = m_entries[i];
+        std::size_t n = m_entries.size();
+
+        while (true) {
+            std::size_t first = firstChild(i);
+            if (first >= n)
+                break;
+
+            // find smallest child
+            std::size_t last = first + Arity < n ? first + Arity : n;
+            std::size_t mi = first;
+            for (std::size_t c = first + 1; c < last; ++c) {
+                if (m_entries[c].m_key < m_entries[mi].m_key)
+                    mi = c;
+            }
+
+            if (!(m_entries[mi].m_key < e.m_key))
+                break;
+
+            place(i, m_entries[mi]);
+            i = mi;
+        }
+
+        place(i, e);
+    }
+
+public:
+    explicit indexed_heap(PositionMap positions = PositionMap()) : m_positions(positions) { }
+
+    bool empty() const { return m_entries.empty(); }
+    std::size_t size() const { return m_entries.size(); }
+
+    void reserve(std::size_t n) { m_entries.reserve(n); }
+
+    /*!
+     * \brief removes all elements. note that the external positions are not reset
+     */
+    void clear() { m_entries.clear(); }
+
+    bool contains(std::size_t index) const
+    {
+        std::size_t pos = m_positions(index);
+        return pos < m_entries.size() && m_entries[pos].m_index == index;
+    }
+
+    std::size_t top() const { return m_entries.front().m_index; }
+    const Key& topKey() const { return m_entries.front().m_key; }
+
+    void push(std::size_t index, const Key& key)
+    {
+        m_entries.push_back({key, index});
+        siftUp(m_entries.size() - 1);
+    }
+
+    /*!
+     * \brief appends an element without restoring the heap property. heapify() must be called before the heap is used again
+     */
+    void append(std::size_t index, const Key& key)
+    {
+        m_positions(index) = m_entries.size();
+        m_entries.push_back({key, index});
+    }
+
+    /*!
+     * \brief restores the heap property after calls to append() in linear time
+     */
+    void heapify()
+    {
+        if (m_entries.size() < 2)
+            return;
+
+        for (std::size_t i = parent(m_entries.size() - 1) + 1; i-- > 0; ) {
+            siftDown(i);
+        }
+    }
+
+    void pop()
+    {
+        erase(top());
+    }
+
+    void erase(std::size_t index)
+    {
+        std::size_t pos = m_positions(index);
+        assert(contains(index));
+
+        m_positions(index) = inv_heap_pos;
+
+        entry last = m_entries.back();
+        m_entries.pop_back();
+
+        if (pos < m_entries.size()) {
+            Key oldKey = m_entries[pos].m_key;
+            place(pos, last);
+
+            if (last.m_key < oldKey)
+                siftUp(pos);
+            else
+                siftDown(pos);
+        }
+    }
+
+    /*!
+     * \brief changes the key of an index to a smaller value
+     */
+    void decrease(std::size_t index, const Key& key)
+    {
+        std::size_t pos = m_positions(index);
+        m_entries[pos].m_key = key;
+        siftUp(pos);
+    }
+
+    /*!
+     * \brief changes the key of an index to a greater value
+     */
+    void increase(std::size_t index, const Key& key)
+    {
+        std::size_t pos = m_positions(index);
+        m_entries[pos].m_key = key;
+        siftDown(pos);
+    }
+
+    /*!
+     * \brief changes the key of an index to any value
+     */
+    void update(std::size_t index, const Key& key)
+    {
+        std::size_t pos = m_positions(index);
+        if (key < m_entries[pos].m_key)
+            decrease(index, key);
+        else
+            increase(index, key);
+    }
+};
+
+#endif // INDEXED_HEAP_HPP
@@ -0,0 +1,134 @@
+#ifndef LAZY_HEAP_HPP
+#define LAZY_HEAP_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+/*!
+ * \brief contiguous d-ary min-heap of (key, index, version) entries without support for updating keys
+ *
+ * Instead of updating an element, a new entry with a higher version is pushed. The owner keeps track of the current
+ * version of every index and discards outdated entries when they reach the top of the heap. This trades memory
+ * for cheaper updates, since no heap positions have to be maintained.
+ */
+template<typename Key, typename Version = unsigned int, unsigned int Arity = 4>
+class lazy_heap
+{
+    static_assert(Arity >= 2, "heap arity must be at least 2");
+
+public:
+    struct entry
+    {
+        Key m_key;
+        Version m_version;
+        std::size_t m_index;
+    };
+
+private:
+    std::vector<entry> m_entries;
+
+    static std::size_t parent(std::size_t i) { return (i - 1) / Arity; }
+    static std::size_t firstChild(std::size_t i) { return i * Arity + 1; }
+
+    void siftUp(std::size_t i)
+    {
+        entry e = m_entries[i];
+
+        while (i > 0) {
+            std::size_t pi = parent(i);
+            if (!(e.m_key < m_entries[pi].m_key))
+                break;
+
+            m_entries[i] = m_entries[pi];
+            i = pi;
+        }
+
+        m_entries[i] = e;
+    }
+
+    void siftDown(std::size_t i)
+    {
+        entry e = m_entries[i];
+        std::size_t n = m_entries.size();
+
+        while (true) {
+            std::size_t first = firstChild(i);
+            if (first >= n)
+                break;
+
+            // find smallest child
+            std::size_t last = first + Arity < n ? first + Arity : n;
+            std::size_t mi = first;
+            for (std::size_t c = first + 1; c < last; ++c) {
+                if (m_entries[c].m_key < m_entries[mi].m_key)
+                    mi = c;
+            }
+
+            if (!(m_entries[mi].m_key < e.m_key))
+                break;
+
+            m_entries[i] = m_entries[mi];
+            i = mi;
+        }
+
+        m_entries[i] = e;
+    }
+
+public:
+    bool empty() const { return m_entries.empty(); }
+    std::size_t size() const { return m_entries.size(); }
+
+    void reserve(std::size_t n) { m_entries.reserve(n); }
+    void clear() { m_entries.clear(); }
+
+    const entry& top() const { return m_entries.front(); }
+
+    void push(std::size_t index, const Key& key, Version version)
+    {
+        m_entries.push_back({key, version, index});
+        siftUp(m_entries.size() - 1);
+    }
+
+    /*!
+     * \brief appends an entry without restoring the heap property. heapify() must be called before the heap is used again
+     */
+    void append(std::size_t index, const Key& key, Version version)
+    {
+        m_entries.push_back({key, version, index});
+    }
+
+    /*!
+     * \brief restores the heap property after calls to append() in linear time
+     */
+    void heapify()
+    {
+        if (m_entries.size() < 2)
+            return;
+
+        for (std::size_t i = parent(m_entries.size() - 1) + 1; i-- > 0; ) {
+            siftDown(i);
+        }
+    }
+
+    void pop()
+    {
+        m_entries.front() = m_entries.back();
+        m_entries.pop_back();
+
+        if (!m_entries.empty())
+            siftDown(0);
+    }
+
+    /*!
+     * \brief removes all entries for which isStale returns true and restores the heap property in linear time
+     */
+    template<typename Predicate>
+    void compact(Predicate isStale)
+    {
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), isStale), m_entries.end());
+        heapify();
+    }
+};
+
+#endif // LAZY_HEAP_HPP
@@ -0,0 +1,11 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <cstddef>
+
+/*!
+ * \brief returns the peak resident set size (peak working set on Windows) of the process in bytes, or 0 if unknown
+ */
+std::size_t peakMemoryUsage();
+
+#endif // MEMORY_USAGE_HPP
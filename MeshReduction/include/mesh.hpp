@@ -10,10 +10,19 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 
 #include <functional>
 
 
+/*!
+ * \brief a corner of a face, or a boundary halfedge
+ *
+ * The halfedges of face f are stored at 3f, 3f+1 and 3f+2 (counter-clockwise), followed by all boundary halfedges.
+ * The bordering face and the next and previous halfedges are therefore implied by the index (see Mesh::eFace,
+ * Mesh::eNext and Mesh::ePrev) and don't need to be stored.
+ */
 struct Halfedge
 {
     /*!
@@ -21,34 +30,30 @@ struct Halfedge
      */
     mesh_index m_vertex;
 
-    /*!
-     * \brief index of the face this halfedge is bordering to the left. if the halfedge is boundary, this index is invalid.
-     */
-    mesh_index m_face;
-
     /*!
      * \brief index of the opposite halfedge. always valid.
      */
     mesh_index m_opposite;
-
-    /*!
-     * \brief index of the next halfedge in the bordering face (counter-clockwise). if the halfedge is boundary, this index is invalid.
-     */
-    mesh_index m_next;
-
-    /*!
-     * \brief index of the previous halfedge in the bordering face (clockwise). if the halfedge is boundary, this index is invalid.
-     */
-    mesh_index m_previous;
 };
 
-const Halfedge inv_edge ({ inv_index, inv_index, inv_index, inv_index, inv_index });
+const Halfedge inv_edge ({ inv_index, inv_index });
 
 inline bool is_valid(const Halfedge& edge)
 {
-    return is_valid(edge.m_vertex) && is_valid(edge.m_face) && is_valid(edge.m_opposite);
+    return is_valid(edge.m_vertex) && is_valid(edge.m_opposite);
 }
 
+/*!
+ * \brief result of Mesh::checkPairContraction
+ */
+enum ContractionResult
+{
+    Contractable,
+    RejectedTopology, // the vertices are not connected, or the collapse would change the topology of the mesh
+    RejectedValency,  // the collapse would create vertices with too few neighbours
+    RejectedFaceFlip  // an adjacent face would flip over
+};
+
 class aiMesh;
 
 class Mesh
@@ -59,39 +64,60 @@ private:
     mutable QMutex m_mutex;
 
     unsigned int m_importedFaceCount, m_importedHalfedgeCount, m_importedVertexCount;
-    unsigned int m_vertexCount;
+    std::atomic<unsigned int> m_vertexCount; // edges which are far enough apart may be collapsed concurrently
+    std::atomic<unsigned int> m_version; // incremented by every collapse
 
-    // connectivity information (winged half edge data)
+    // connectivity information (corner table, see Halfedge)
     std::vector<Halfedge> m_edges;
-    std::vector<mesh_index> m_faceEdges;
+    mesh_index m_boundaryBegin; // index of the first boundary halfedge (three times the number of faces)
     std::vector<mesh_index> m_vertexEdges; // if vertex is boundary: always boundary edge!
+    std::vector<mesh_index> m_vertexSources; // index of the imported vertex every vertex originates from
+    std::vector<unsigned int> m_vertexValencies; // number of neighbours of every vertex, maintained by collapseEdge()
+    std::vector<unsigned int> m_vertexVersions; // m_version of the last collapse which changed the one-ring of every vertex
+
+    // face geometry, updated by collapseEdge() for all faces around the remaining vertex
+    std::vector<glm::vec3> m_faceNormals;
+    std::vector<float> m_faceAreas;
 
     // drawing data
     std::vector<glm::vec3> m_vertexPositions, m_vertexNormals;
     std::vector<unsigned int> m_indices;
 
     void processImportedMesh();
+    void buildConnectivity(unsigned int numFaces, const std::function<const unsigned int*(unsigned int)>& faceIndices,
+                           bool splitClosedFans);
     void computeIndices();
 
     mesh_index duplicateVertex(mesh_index v);
+    void updateFaceGeometry(mesh_index f);
 
-    template<typename T>
-    void cleanupPrimitives(T& container, std::function<void(mesh_index, mesh_index)> replaceFun) {
-        auto begin = container.begin();
-        auto first = begin, last = container.end();
-        first = std::find_if(first, last, [] (const typename T::value_type& elem) { return !is_valid(elem); });
-
-        if (first != last) {
-            for (auto it = first; ++it != last; ) {
-                if (is_valid(*it)) {
-                    replaceFun(first - begin, it - begin);
-                    ++first;
-                }
+    /*!
+     * \brief epoch-tagged vertex marks. a vertex is marked if its entry equals the current epoch, so all marks can be
+     * cleared in constant time
+     */
+    struct VertexMarks
+    {
+        std::vector<unsigned int> m_marks;
+        unsigned int m_epoch;
+
+        VertexMarks() : m_epoch(0) { }
+
+        void clear(std::size_t vertexCount)
+        {
+            if (m_marks.size() < vertexCount)
+                m_marks.resize(vertexCount, 0);
+
+            if (++m_epoch == 0) { // wrapped around: old marks could become valid again
+                std::fill(m_marks.begin(), m_marks.end(), 0);
+                m_epoch = 1;
             }
         }
+    };
 
-        container.erase(first, last);
-    }
+    // one-ring queries run concurrently during parallel decimation, so every thread needs its own marks
+    static VertexMarks& localVertexMarks();
+
+    Mesh(const Mesh& other);
 
     void runTests();
     void runVertexTest(mesh_index v);
@@ -108,6 +134,11 @@ public:
 
     bool isDirty() const;
 
+    /*!
+     * \brief number of collapses since the connectivity was built
+     */
+    unsigned int version() const { return m_version.load(std::memory_order_relaxed); }
+
 
     // edge queries
     mesh_index eVertex(mesh_index e) const { return m_edges[e].m_vertex; }
@@ -120,13 +151,14 @@ public:
     glm::vec3 eVector(mesh_index e) const;
     glm::vec3 eDirection(mesh_index e) const;
 
-    mesh_index eFace(mesh_index e) const { return m_edges[e].m_face; }
+    mesh_index eFace(mesh_index e) const { return eIsBoundary(e) ? inv_index : e / 3; }
 
     mesh_index eOpposite(mesh_index e) const { return m_edges[e].m_opposite; }
-    mesh_index eNext(mesh_index e) const { return m_edges[e].m_next; }
-    mesh_index ePrev(mesh_index e) const { return m_edges[e].m_previous; }
+    mesh_index eNext(mesh_index e) const { return eIsBoundary(e) ? inv_index : (e % 3 == 2 ? e - 2 : e + 1); }
+    mesh_index ePrev(mesh_index e) const { return eIsBoundary(e) ? inv_index : (e % 3 == 0 ? e + 2 : e - 1); }
 
-    bool eIsBoundary(mesh_index e) const { return !is_valid(m_edges[e].m_face); }
+    bool eIsBoundary(mesh_index e) const { return e >= m_boundaryBegin; }
+    bool eIsValid(mesh_index e) const { return is_valid(m_edges[e]); }
 
     edge_fan eFan(mesh_index e) const { return edge_fan(this, e); }
     edge_fan_iterator eFanBegin(mesh_index e) const { return edge_fan_iterator(this, e, e); }
@@ -135,26 +167,50 @@ public:
 
     // vertex queries
     mesh_index vEdge(mesh_index v) const { return m_vertexEdges[v]; }
+    bool vIsValid(mesh_index v) const { return is_valid(m_vertexEdges[v]); }
+
+    /*!
+     * \brief index of the imported vertex v originates from. this stays the same when vertices are split apart
+     * (non-manifold geometry) or moved by cleanupData()
+     */
+    mesh_index vSource(mesh_index v) const { return m_vertexSources[v]; }
+
+    /*!
+     * \brief version() of the last collapse which changed the one-ring of v: its neighbours, their positions or their
+     * valencies. a result of checkPairContraction stays valid until the version of one of the two vertices exceeds the
+     * version() it was computed at, as long as more than four valid vertices are left
+     */
+    unsigned int vVersion(mesh_index v) const { return m_vertexVersions[v]; }
     mesh_index vConnectingEdge(mesh_index v, mesh_index v1) const;
 
     edge_fan vEdgeFan(mesh_index v) const { return edge_fan(this, vEdge(v)); }
     edge_fan_iterator vEdgeFanBegin(mesh_index v) const { return eFanBegin(vEdge(v)); }
     edge_fan_iterator vEdgeFanEnd(mesh_index v) const { return eFanEnd(vEdge(v)); }
 
-    unsigned int vValency(mesh_index v) const;
+    unsigned int vValency(mesh_index v) const { return m_vertexValencies[v]; }
 
     bool vIsBoundary(mesh_index v) const { return eIsBoundary(vEdge(v)); }
     bool vIsConnected(mesh_index v, mesh_index v1) const { return is_valid(vConnectingEdge(v, v1)); }
 
+    /*!
+     * \brief calls fn for every vertex connected to both v0 and v1, until fn returns false
+     *
+     * The neighbours of v1 are marked first, so this takes time linear in the valencies of v0 and v1. May be called by
+     * several threads at once, but fn must not call it again.
+     * \return false if fn has stopped the enumeration
+     */
+    template<typename Fn>
+    bool vForEachSharedNeighbour(mesh_index v0, mesh_index v1, Fn&& fn) const;
+
     const glm::vec3& vPosition(mesh_index v) const { return m_vertexPositions[v]; }
     const glm::vec3& vNormal(mesh_index v) const { return m_vertexNormals[v]; }
 
 
     // face queries
-    mesh_index fEdge(mesh_index f) const { return m_faceEdges[f]; }
+    mesh_index fEdge(mesh_index f) const { return eIsValid(f*3) ? f*3 : inv_index; }
 
-    glm::vec3 fNormal(mesh_index f) const;
-    float fArea(mesh_index f) const;
+    const glm::vec3& fNormal(mesh_index f) const { return m_faceNormals[f]; }
+    float fArea(mesh_index f) const { return m_faceAreas[f]; }
 
 
     void prepareDrawingData();
@@ -162,15 +218,40 @@ public:
     void recomputeNormals();
     void cleanupData();
 
-    bool isPairContractable(mesh_index v0, mesh_index v1, const glm::vec3& newPos) const;
+    /*!
+     * \brief returns a copy of the mesh without collapsed primitives and with recomputed normals, as cleanupData() and
+     * recomputeNormals() would leave it. the mesh itself is not modified. the copy refers to the same imported mesh
+     */
+    std::unique_ptr<Mesh> compactCopy() const;
+
+    /*!
+     * \brief replaces the mesh with a new list of triangles (three vertex indices each), e.g. the result of VertexClusterer.
+     * every vertex must be used by a face. reset() restores the imported mesh
+     * \param sources index of the imported vertex every new vertex originates from (see vSource)
+     */
+    void assignTriangles(std::vector<glm::vec3> positions, std::vector<glm::vec3> normals, std::vector<mesh_index> sources,
+                         const std::vector<unsigned int>& indices);
+
+    ContractionResult checkPairContraction(mesh_index v0, mesh_index v1, const glm::vec3& newPos) const;
+    bool isPairContractable(mesh_index v0, mesh_index v1, const glm::vec3& newPos) const {
+        return checkPairContraction(v0, v1, newPos) == Contractable;
+    }
+
+    /*!
+     * \brief collapses an edge and returns the number of removed faces
+     *
+     * Only the faces around the edge and the vertex edges of their corners are modified. Edges whose end points are at
+     * least three edges apart can therefore be tested and collapsed concurrently.
+     */
     unsigned int collapseEdge(mesh_index e, const glm::vec3& newPos);
 
 
     unsigned int vertexCount() const { return m_vertexEdges.size(); }
+    unsigned int validVertexCount() const { return m_vertexCount.load(std::memory_order_relaxed); }
     unsigned int indexCount() const { return m_indices.size(); }
     unsigned int halfedgeCount() const { return m_edges.size(); }
     unsigned int edgeCount() const { return halfedgeCount() / 2; }
-    unsigned int faceCount() const { return m_faceEdges.size(); }
+    unsigned int faceCount() const { return m_boundaryBegin / 3; }
 
     unsigned int importedFaceCount() const { return m_importedFaceCount; }
     unsigned int importedEdgeCount() const { return m_importedHalfedgeCount / 2; }
@@ -187,4 +268,24 @@ public:
     aiMesh* makeExportMesh() const;
 };
 
+template<typename Fn>
+bool Mesh::vForEachSharedNeighbour(mesh_index v0, mesh_index v1, Fn&& fn) const
+{
+    VertexMarks& marks = localVertexMarks();
+    marks.clear(m_vertexEdges.size());
+
+    for (mesh_index e : vEdgeFan(v1)) {
+        marks.m_marks[eEndVertex(e)] = marks.m_epoch;
+    }
+
+    for (mesh_index e : vEdgeFan(v0)) {
+        mesh_index v2 = eEndVertex(e);
+
+        if (marks.m_marks[v2] == marks.m_epoch && !fn(v2))
+            return false;
+    }
+
+    return true;
+}
+
 #endif // MESH_HPP
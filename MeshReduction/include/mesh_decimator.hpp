@@ -2,21 +2,84 @@
 #define MESH_DECIMATOR_HPP
 
 #include <vector>
-#include <unordered_map>
 #include <functional>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <memory>
 
 #include <QObject>
-#include <QMutex>
+#include <QElapsedTimer>
 
 #include "boost/heap/fibonacci_heap.hpp"
 
+#include "indexed_heap.hpp"
+#include "lazy_heap.hpp"
+#include "quadric_batch.hpp"
+#include "decimation_stats.hpp"
+
 #include "util.hpp"
 #include "mesh_index.hpp"
+#include "mesh.hpp"
+
+/*!
+ * \brief value representing an invalid vertex pair index
+ */
+const mesh_index inv_pair(-1);
 
-class Mesh;
+/*!
+ * \brief value of VertexPair::m_checkedResult if the pair has not been tested yet
+ */
+const unsigned char unchecked_result(-1);
 
 class MeshDecimator : public QObject
 {
+public:
+    /*!
+     * \brief priority queue implementation used to sort vertex pairs by cost
+     */
+    enum QueueType
+    {
+        FibonacciHeap, // node based boost::heap::fibonacci_heap
+        IndexedHeap,   // contiguous 4-ary heap addressed by pair index
+        LazyHeap       // contiguous 4-ary heap of versioned entries, updates push new entries and outdated ones are skipped
+    };
+
+    /*!
+     * \brief floating point type used for the error quadrics
+     */
+    enum Precision
+    {
+        SinglePrecision, // float (quadric math is vectorized)
+        DoublePrecision  // double
+    };
+
+    /*!
+     * \brief method used to find the optimal position of a contracted pair
+     */
+    enum Solver
+    {
+        DeterminantSolver,  // invert the quadric matrix, fall back to end points or midpoint if its determinant is too small
+        PseudoInverseSolver // pseudo-inverse with a tolerance relative to the largest eigenvalue (independent of model scale)
+    };
+
+    /*!
+     * \brief order in which edges are collapsed
+     */
+    enum Strategy
+    {
+        GreedyStrategy,         // always collapse the cheapest pair of the whole mesh (global priority queue)
+        MultipleChoiceStrategy, // sample a few random edges and collapse the cheapest of them (no queue)
+        BatchedStrategy,        // per round, collapse an independent set among the cheapest fraction of all edges
+        ParallelStrategy        // like BatchedStrategy, but the edges of a round are far enough apart to be collapsed concurrently
+    };
+
+    /*!
+     * \brief returns the number of heap allocations of the process so far (see setAllocationCounter)
+     */
+    typedef unsigned long long (*AllocationCounter)();
+
+private:
     class VertexPair;
 
     struct VertexPairCostComparer
@@ -30,19 +93,55 @@ class MeshDecimator : public QObject
         }
     };
 
+    struct VertexPairHeapPosition
+    {
+        std::vector<VertexPair>* m_pairs;
+
+        VertexPairHeapPosition(std::vector<VertexPair>& pairs) : m_pairs(&pairs) { }
+
+        std::size_t& operator()(std::size_t p) const {
+            return (*m_pairs)[p].m_heapPos;
+        }
+    };
+
     typedef boost::heap::fibonacci_heap<std::size_t, boost::heap::compare<VertexPairCostComparer>> priority_queue;
+    typedef indexed_heap<float, VertexPairHeapPosition> pair_heap;
+    typedef lazy_heap<float> lazy_pair_heap;
 
-    struct VertexPair
+    /*!
+     * \brief a vertex pair with its optimal position and cost, without any queue bookkeeping. the strategies without
+     * a global queue evaluate their pairs of a round or step as candidates
+     */
+    struct PairCandidate
     {
         mesh_index m_v0, m_v1;
         glm::vec3 m_newPos;
         float m_cost;
+
+        PairCandidate(mesh_index v0, mesh_index v1) : m_v0(v0), m_v1(v1) { }
+    };
+
+    struct VertexPair : PairCandidate
+    {
         bool m_removed;
+        bool m_deferred; // pair is in m_deferredPairs
+        unsigned char m_checkedResult; // cached result of the last contraction test, or unchecked_result
         priority_queue::handle_type m_handle;
+        std::size_t m_heapPos;
+        unsigned int m_version; // version of the current entry in the lazy heap
+        unsigned int m_checkedVersion; // mesh version of the last contraction test (see Mesh::vVersion)
 
-        VertexPair(mesh_index v0, mesh_index v1) : m_v0(v0), m_v1(v1), m_removed(true) { }
+        // intrusive doubly linked lists of all pairs sharing a vertex (index 0: list of m_v0, index 1: list of m_v1)
+        mesh_index m_nextPair[2], m_prevPair[2];
+
+        VertexPair(mesh_index v0, mesh_index v1) : PairCandidate(v0, v1), m_removed(true), m_deferred(false), m_checkedResult(unchecked_result),
+            m_heapPos(inv_heap_pos), m_version(0), m_checkedVersion(0), m_nextPair{inv_pair, inv_pair}, m_prevPair{inv_pair, inv_pair} { }
 
         bool isValid() const { return is_valid(m_v0) && is_valid(m_v1); }
+
+        unsigned int slot(mesh_index v) const { return (m_v0 == v) ? 0 : 1; }
+        mesh_index vertex(unsigned int s) const { return s ? m_v1 : m_v0; }
+        mesh_index otherVertex(mesh_index v) const { return (m_v0 == v) ? m_v1 : m_v0; }
         void invalidate() { m_v0 = m_v1 = inv_index; }
 
         bool isRemoved() const { return m_removed; }
@@ -50,43 +149,258 @@ class MeshDecimator : public QObject
         void unremove() { m_removed = false; }
     };
 
+    /*!
+     * \brief scratch buffers for evaluating the costs of many pairs at once
+     */
+    struct PairCostBatch
+    {
+        quadric_batch m_quadrics;
+        std::vector<glm::vec3> m_positions;
+        std::vector<float> m_costs;
+        std::vector<unsigned char> m_solved;
+
+        // candidate positions of pairs whose quadric is singular (three per pair)
+        quadric_batch m_fallbackQuadrics;
+        std::vector<glm::vec3> m_fallbackPositions;
+        std::vector<float> m_fallbackCosts;
+
+        PairCostBatch();
+    };
+
     Q_OBJECT
 
 private:
     Mesh * m_mesh;
     unsigned int m_targetFaceCount, m_oldFaceCount, m_currentFaceCount, m_lastAttemptFaceCount;
 
-    bool m_abort;
+    std::atomic<bool> m_abort;
+
+    // progress reporting policy
+    int m_progressInterval;
+    float m_progressStep;
+    float m_lastProgress;
+    QElapsedTimer m_progressTimer;
 
+    DecimationStats m_stats;
+    bool m_queueProfiling;
+    AllocationCounter m_allocationCounter;
+
+    Strategy m_strategy;
+    unsigned int m_candidateCount; // edges sampled per collapse (MultipleChoiceStrategy)
+    float m_batchFraction; // fraction of the cheapest edges considered per round (BatchedStrategy)
+    std::minstd_rand m_random;
+
+    QueueType m_queueType;
+    Precision m_precision;
+    Solver m_solver;
     VertexPairCostComparer m_costComparer;
 
-    std::vector<Quadric> m_quadrics; // quadrics for every vertex
+    std::vector<Quadric> m_quadrics; // quadrics for every vertex (if m_precision == SinglePrecision)
+    std::vector<QuadricD> m_doubleQuadrics; // quadrics for every vertex (if m_precision == DoublePrecision)
     std::vector<VertexPair> m_pairs; // all valid vertex pairs
-    priority_queue m_pairsByCost; // vertex pairs sorted by cost
-    std::unordered_multimap<mesh_index, std::size_t> m_pairsByVertex; // vertex pairs keyed by the vertices they contain
+    priority_queue m_pairsByCost; // vertex pairs sorted by cost (if m_queueType == FibonacciHeap)
+    pair_heap m_pairHeap; // vertex pairs sorted by cost (if m_queueType == IndexedHeap)
+    lazy_pair_heap m_lazyHeap; // vertex pairs sorted by cost (if m_queueType == LazyHeap)
+    std::vector<mesh_index> m_pairsByVertex; // first pair of the pair list of every vertex
+    std::vector<bool> m_lockedVertices; // indexed by imported vertex (see Mesh::vSource). empty if nothing is locked
+
+    std::vector<unsigned int> m_lodFaceCounts; // in descending order
+    std::vector<std::unique_ptr<Mesh>> m_lodMeshes; // copies taken so far, one per element of m_lodFaceCounts
+
+    // scratch buffers of iterate(): a vertex is marked if m_vertexMarks[v] == m_markEpoch
+    std::vector<unsigned int> m_vertexMarks;
+    std::vector<mesh_index> m_markedPairs; // pair connecting v0 with a marked vertex
+    unsigned int m_markEpoch;
+
+    PairCostBatch m_costBatch; // scratch buffers of iterate()
+    std::vector<std::size_t> m_updatedPairs; // pairs of v0 whose cost is updated after a collapse
+    std::vector<float> m_oldCosts;
 
-    mutable QMutex m_mutex;
+    // pairs which were rejected by checkPairContraction. they are re-examined after collapses in their neighbourhood,
+    // and once more when the queue runs empty if one of their vertices changed after their last test
+    std::vector<std::size_t> m_deferredPairs;
+
+    // scratch buffers of the multiple choice and batched strategies
+    std::vector<mesh_index> m_liveVertices; // all vertices which have not been collapsed yet
+    std::vector<mesh_index> m_liveVertexPos; // position of every vertex in m_liveVertices
+    std::vector<PairCandidate> m_candidates; // sampled pairs (MultipleChoiceStrategy) or all pairs of a round
+    std::vector<std::size_t> m_batchOrder;
+    std::vector<ContractionResult> m_batchResults;
+    std::vector<std::size_t> m_checkedPairs;
+    std::vector<std::size_t> m_selectedPairs;
+    unsigned int m_failedSamples;
 
     MeshDecimator(const MeshDecimator& other) = delete;
     MeshDecimator& operator=(const MeshDecimator& other) = delete;
     MeshDecimator& operator=(MeshDecimator&& other) = delete;
 
     void computeQuadrics();
-    void computePairCost(std::size_t p);
+    template<typename T>
+    void computeQuadrics(std::vector<BasicQuadric<T>>& quadrics);
+    void mergeQuadrics(mesh_index v0, mesh_index v1);
+
+    template<typename T>
+    void evaluatePairCost(PairCandidate& pair, const std::vector<BasicQuadric<T>>& quadrics) const;
+    template<typename Pair>
+    void evaluatePairCosts(std::vector<Pair>& pairs, const std::size_t* indices, std::size_t count, PairCostBatch& batch);
+    void computePairCosts(const std::size_t* pairs, std::size_t count);
+    template<typename Pair>
+    void collectPairs(std::vector<Pair>& pairs);
     void initPairs();
-    void cleanupPairs();
+    void deferPair(std::size_t p);
+    void retryDeferredPairs();
     void initHelpers();
 
-    bool isPairContractable(const VertexPair& pair) const;
+    // per-vertex pair lists
+    void linkPair(std::size_t p, unsigned int s);
+    void unlinkPair(std::size_t p, unsigned int s);
+    void unlinkPair(std::size_t p);
+
+    // vertex marks
+    void resetMarks();
+    void nextMarkEpoch();
+
+    // priority queue abstraction
+    bool queueEmpty();
+    std::size_t queuePop();
+    void queuePush(std::size_t p);
+    void queueAppend(std::size_t p);
+    void queueBuild();
+    void queueUpdate(std::size_t p, float oldCost);
+    void queueClear();
+
+    // lazy heap
+    bool isEntryCurrent(const lazy_pair_heap::entry& e) const;
+    void lazyPush(std::size_t p);
+
+    bool isVertexLocked(mesh_index v) const { return !m_lockedVertices.empty() && m_lockedVertices[m_mesh->vSource(v)]; }
+
+    ContractionResult checkPairContraction(VertexPair& pair) const;
+    bool isPairContractable(VertexPair& pair) const;
+
+    void evaluateCandidate(PairCandidate& pair) const;
+    ContractionResult checkCandidateContraction(const PairCandidate& pair) const;
+    bool countContraction(ContractionResult result);
+    bool acceptContraction(VertexPair& pair);
+    bool acceptCandidate(const PairCandidate& pair);
+    void contractPair(mesh_index v0, mesh_index v1, const glm::vec3& newPos);
+
+    void initLiveVertices();
+    void removeLiveVertex(mesh_index v);
 
     bool iterate();
+    bool iterateGreedy();
+    bool iterateMultipleChoice();
+    bool iterateBatched();
+    bool iterateParallel();
+    std::size_t sortCheapestPairs();
+    void markNeighbourhood(mesh_index v0, mesh_index v1, unsigned int rings);
 
-    void updateProgress();
+    unsigned int roundTargetFaceCount() const;
+    void takeLodSnapshots(bool final);
+
+    void updateProgress(bool force = false);
 
 public:
-    MeshDecimator(Mesh * mesh, unsigned int targetFaceCount);
+    MeshDecimator(Mesh * mesh, unsigned int targetFaceCount, QueueType queueType = IndexedHeap);
     ~MeshDecimator();
 
+    QueueType queueType() const { return m_queueType; }
+
+    Strategy strategy() const { return m_strategy; }
+    unsigned int candidateCount() const { return m_candidateCount; }
+    float batchFraction() const { return m_batchFraction; }
+
+    /*!
+     * \brief sets the collapse order. must be called before start()
+     *
+     * The multiple choice and batched strategies trade a little quality for speed and need much less memory,
+     * since they do not maintain a global priority queue (the queue type is ignored).
+     */
+    void setStrategy(Strategy strategy) { m_strategy = strategy; }
+
+    /*!
+     * \brief sets the number of edges sampled per collapse by MultipleChoiceStrategy
+     */
+    void setCandidateCount(unsigned int count) { m_candidateCount = std::max(1u, count); }
+
+    /*!
+     * \brief sets the fraction (0-1) of the cheapest edges which BatchedStrategy tries to collapse per round
+     */
+    void setBatchFraction(float fraction) { m_batchFraction = fraction; }
+
+    /*!
+     * \brief prevents vertices from being moved or removed. must be called before start()
+     * \param locked one flag per imported vertex of the mesh. edges with a locked end point are never collapsed
+     */
+    void setLockedVertices(std::vector<bool> locked) { m_lockedVertices = std::move(locked); }
+
+    /*!
+     * \brief sets the face counts of additional levels of detail. must be called before start()
+     *
+     * Whenever the face count drops to one of these counts during start(), a compacted copy of the mesh is taken (see
+     * Mesh::compactCopy), so that a whole chain of levels can be generated in a single run. The target face count
+     * passed to the constructor should be the smallest one. Levels which are not reached before the decimation stops
+     * are copies of the final mesh.
+     */
+    void setLodFaceCounts(std::vector<unsigned int> faceCounts);
+    const std::vector<unsigned int>& lodFaceCounts() const { return m_lodFaceCounts; }
+
+    /*!
+     * \brief returns the levels of detail of the last run, in the order of lodFaceCounts(). the decimator gives up ownership
+     */
+    std::vector<std::unique_ptr<Mesh>> takeLodMeshes() { return std::move(m_lodMeshes); }
+
+    /*!
+     * \brief measurements of the last run (valid after start() has returned)
+     */
+    const DecimationStats& stats() const { return m_stats; }
+
+    bool queueProfiling() const { return m_queueProfiling; }
+
+    /*!
+     * \brief enables measuring the time spent in priority queue operations (see DecimationStats::m_queueMs).
+     * this is disabled by default, since it adds two timer queries to every queue operation
+     */
+    void setQueueProfiling(bool enabled) { m_queueProfiling = enabled; }
+
+    AllocationCounter allocationCounter() const { return m_allocationCounter; }
+
+    /*!
+     * \brief sets a function counting heap allocations (e.g. in a replaced operator new). if set, the allocations made
+     * by the collapse loop are recorded in DecimationStats::m_iterateAllocations. nullptr (the default) disables this
+     */
+    void setAllocationCounter(AllocationCounter counter) { m_allocationCounter = counter; }
+
+    Precision precision() const { return m_precision; }
+    Solver solver() const { return m_solver; }
+
+    /*!
+     * \brief sets the floating point type of the error quadrics. must be called before start()
+     */
+    void setPrecision(Precision precision) { m_precision = precision; }
+
+    /*!
+     * \brief sets the method used to find optimal vertex positions. must be called before start()
+     */
+    void setSolver(Solver solver) { m_solver = solver; }
+
+    int progressInterval() const { return m_progressInterval; }
+    float progressStep() const { return m_progressStep; }
+
+    /*!
+     * \brief sets the minimum time between two progressChanged signals in milliseconds (0 = no limit)
+     */
+    void setProgressInterval(int msec) { m_progressInterval = msec; }
+
+    /*!
+     * \brief sets the minimum progress (0-1) between two progressChanged signals (0 = no limit)
+     *
+     * progressChanged is emitted as soon as both the interval and the step have been reached, and once more
+     * when the decimation has finished.
+     */
+    void setProgressStep(float step) { m_progressStep = step; }
+
     float progress() const;
     bool isAborting() const;
 
@@ -98,6 +412,11 @@ signals:
     void finished();
     void progressChanged(float value);
     void error(QString msg);
+
+    /*!
+     * \brief emitted at the end of start(), right before finished()
+     */
+    void statsAvailable(DecimationStats stats);
 };
 
 #endif // MESH_DECIMATOR_HPP
@@ -7,6 +7,7 @@
 #include <QAction>
 
 #include "ui_meshreduction.h"
+#include "decimation_stats.hpp"
 
 #define MAX_RECENTFILES 10
 
@@ -29,6 +30,7 @@ private:
     MeshViewer* m_glWidget;
 
     std::unique_ptr<QProgressDialog> m_progressDialog;
+    QString m_decimationSummary; // summary of the stats of the last decimation
 
     QAction* m_recentFileActions[MAX_RECENTFILES];
 
@@ -37,6 +39,7 @@ private:
     void populateMeshList();
 
     void setIsDecimating(bool value);
+    void runDecimator(QObject* decimator, const QString& label);
 
 public:
 	MeshReduction(QWidget *parent = 0);
@@ -68,7 +71,9 @@ private slots:
     void updateMeshProperties();
     void resetMesh();
     void decimateMesh();
+    void decimateAllMeshes();
     void onDecimateProgress(float value);
+    void onDecimateStats(const DecimationStats& stats);
     void onStartDecimating();
     void onFinishDecimating();
 
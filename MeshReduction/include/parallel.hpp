@@ -0,0 +1,15 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+#include <cstddef>
+
+/*!
+ * \brief calls fn(begin, end) for consecutive chunks of the index range [0, count), distributed over the global thread pool
+ *
+ * The calling thread processes chunks as well and only returns once the whole range has been processed, so this may
+ * also be called from within a pool thread. Ranges of at most grainSize indices are processed on the calling thread.
+ */
+void parallel_for(std::size_t count, const std::function<void(std::size_t, std::size_t)>& fn, std::size_t grainSize = 4096);
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,74 @@
+#ifndef QUADRIC_BATCH_HPP
+#define QUADRIC_BATCH_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include "util.hpp"
+
+/*!
+ * \brief instruction set used by quadric_batch
+ */
+enum SimdLevel
+{
+    SimdScalar, // plain C++
+    SimdSSE,    // 4 quadrics at a time
+    SimdAVX     // 8 quadrics at a time
+};
+
+/*!
+ * \brief a batch of quadrics in structure-of-arrays layout, which is evaluated and solved with SIMD instructions
+ *
+ * The instruction set is chosen at runtime depending on what the CPU supports. All code paths use the same order of
+ * operations as Quadric::operator() and Quadric::optimum(), so the results do not depend on the instruction set.
+ */
+class quadric_batch
+{
+public:
+    enum Component { A11, A12, A13, A22, A23, A33, B1, B2, B3, C, ComponentCount };
+
+private:
+    std::vector<float> m_data[ComponentCount];
+
+public:
+    std::size_t size() const { return m_data[C].size(); }
+    bool empty() const { return m_data[C].empty(); }
+
+    void reserve(std::size_t n);
+    void clear();
+
+    void push_back(const Quadric& Q);
+
+    const float* component(Component c) const { return m_data[c].data(); }
+
+    /*!
+     * \brief computes the position with minimal error and the error at that position for every quadric (see Quadric::optimum)
+     * \param solved receives 1 for every quadric which could be solved and 0 for singular ones.
+     * positions and costs of singular quadrics are undefined
+     */
+    void optimum(glm::vec3* positions, float* costs, unsigned char* solved) const;
+
+    /*!
+     * \brief evaluates every quadric at the respective position
+     */
+    void evaluate(const glm::vec3* positions, float* costs) const;
+
+    /*!
+     * \brief highest instruction set supported by the CPU
+     */
+    static SimdLevel supportedSimdLevel();
+
+    /*!
+     * \brief instruction set currently used by all batches
+     */
+    static SimdLevel simdLevel();
+
+    /*!
+     * \brief selects the instruction set used by all batches. levels not supported by the CPU are lowered accordingly
+     */
+    static void setSimdLevel(SimdLevel level);
+
+    static const char* simdLevelName(SimdLevel level);
+};
+
+#endif // QUADRIC_BATCH_HPP
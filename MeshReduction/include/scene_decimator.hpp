@@ -0,0 +1,132 @@
+#ifndef SCENE_DECIMATOR_HPP
+#define SCENE_DECIMATOR_HPP
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include <QObject>
+#include <QMutex>
+
+#include "mesh_decimator.hpp"
+
+class Mesh;
+class SceneFile;
+
+/*!
+ * \brief decimates all meshes of a scene, running one MeshDecimator per mesh on a bounded thread pool
+ */
+class SceneDecimator : public QObject
+{
+    Q_OBJECT
+
+private:
+    class Worker;
+
+    struct Job
+    {
+        Mesh* m_mesh;
+        unsigned int m_meshIndex;
+        unsigned int m_targetFaceCount;
+        unsigned int m_weight; // number of faces this job is going to remove
+    };
+
+    std::vector<Job> m_jobs; // sorted by descending face count
+    std::unique_ptr<std::atomic<float>[]> m_jobProgress;
+    unsigned long long m_totalWeight;
+
+    std::vector<DecimationStats> m_meshStats; // indexed by mesh, written by the job of the respective mesh
+    std::vector<double> m_lodRatios;
+    std::vector<std::vector<std::unique_ptr<Mesh>>> m_lodMeshes; // indexed by mesh, written by the job of the respective mesh
+    DecimationStats m_stats;
+
+    int m_maxThreadCount;
+    MeshDecimator::Strategy m_strategy;
+    MeshDecimator::Precision m_precision;
+    MeshDecimator::Solver m_solver;
+
+    std::atomic<std::size_t> m_nextJob;
+    std::atomic<bool> m_abort;
+    std::atomic<int> m_lastProgressStep;
+
+    QMutex m_mutex; // guards m_activeDecimators
+    std::vector<MeshDecimator*> m_activeDecimators;
+
+    SceneDecimator(const SceneDecimator& other) = delete;
+    SceneDecimator& operator=(const SceneDecimator& other) = delete;
+
+    void runJobs();
+    void runJob(std::size_t j);
+    void setJobProgress(std::size_t j, float value);
+
+public:
+    /*!
+     * \brief creates a decimator for all meshes in the scene
+     * \param targetRatio target face count of every mesh, relative to its imported face count
+     * \param maxThreadCount maximum number of meshes decimated concurrently (0 = number of cores)
+     */
+    SceneDecimator(SceneFile* scene, double targetRatio, int maxThreadCount = 0);
+    ~SceneDecimator();
+
+    unsigned int jobCount() const { return m_jobs.size(); }
+
+    /*!
+     * \brief measurements of all meshes combined (valid after start() has returned). times are summed up over all meshes,
+     * so they exceed the wall clock time when meshes are decimated concurrently
+     */
+    const DecimationStats& stats() const { return m_stats; }
+
+    /*!
+     * \brief measurements of a single mesh of the scene (valid after start() has returned)
+     */
+    const DecimationStats& meshStats(unsigned int meshIndex) const { return m_meshStats[meshIndex]; }
+
+    /*!
+     * \brief sets additional levels of detail in descending order, relative to the imported face count of every mesh.
+     * must be called before start() (see MeshDecimator::setLodFaceCounts)
+     */
+    void setLodRatios(std::vector<double> ratios) { m_lodRatios = std::move(ratios); }
+    const std::vector<double>& lodRatios() const { return m_lodRatios; }
+
+    /*!
+     * \brief levels of detail of a single mesh, in descending order of face count (valid after start() has returned).
+     * empty if the mesh was not decimated
+     */
+    const std::vector<std::unique_ptr<Mesh>>& lodMeshes(unsigned int meshIndex) const { return m_lodMeshes[meshIndex]; }
+
+    int maxThreadCount() const { return m_maxThreadCount; }
+
+    MeshDecimator::Strategy strategy() const { return m_strategy; }
+    MeshDecimator::Precision precision() const { return m_precision; }
+    MeshDecimator::Solver solver() const { return m_solver; }
+
+    /*!
+     * \brief sets the collapse order of all mesh decimators (see MeshDecimator::setStrategy)
+     */
+    void setStrategy(MeshDecimator::Strategy strategy) { m_strategy = strategy; }
+
+    /*!
+     * \brief sets the quadric precision of all mesh decimators (see MeshDecimator::setPrecision)
+     */
+    void setPrecision(MeshDecimator::Precision precision) { m_precision = precision; }
+
+    /*!
+     * \brief sets the solver of all mesh decimators (see MeshDecimator::setSolver)
+     */
+    void setSolver(MeshDecimator::Solver solver) { m_solver = solver; }
+
+    float progress() const;
+    bool isAborting() const;
+
+public slots:
+    void start();
+    void abort();
+
+signals:
+    void finished();
+    void progressChanged(float value);
+    void error(QString msg);
+    void statsAvailable(DecimationStats stats);
+};
+
+#endif // SCENE_DECIMATOR_HPP
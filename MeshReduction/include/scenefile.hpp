@@ -2,7 +2,7 @@
 #define MESHFILE_H
 
 #include <QString>
-#include <assimp\Importer.hpp>
+#include <assimp/Importer.hpp>
 
 #include <vector>
 #include <memory>
@@ -15,6 +15,7 @@ struct ExportFormat
 };
 
 class Mesh;
+struct aiMesh;
 
 class SceneFile
 {
@@ -26,18 +27,30 @@ private:
     std::vector<std::unique_ptr<Mesh>> m_meshes;
 
 public:
-    SceneFile(const QString& fileName);
+    /*!
+     * \brief imports a scene file
+     * \param buildMeshes if false, no Mesh is created for the imported meshes (numMeshes() returns 0). the imported data
+     * is still available through importedScene(), e.g. for StreamingDecimator, which only ever builds parts of a mesh
+     */
+    SceneFile(const QString& fileName, bool buildMeshes = true);
 
 	inline const QString& fileName() const { return m_fileName; }
     inline QString errorString() const { return QString(m_importer.GetErrorString()); }
     inline bool hasError() const { return !m_importer.GetScene(); }
 
+    inline const aiScene* importedScene() const { return m_importedScene; }
+
     inline unsigned int numMeshes() const { return m_meshes.size(); }
     inline Mesh* getMesh(unsigned int index) { return m_meshes[index].get(); }
     inline const Mesh* getMesh(unsigned int index) const { return m_meshes[index].get(); }
 
     QString exportToFile(const QString& fileName, const QString& formatId, const std::vector<bool>& includedMeshMask) const;
 
+    /*!
+     * \brief exports the given meshes together with the materials of the imported scene. takes ownership of the meshes
+     */
+    QString exportMeshes(const QString& fileName, const QString& formatId, const std::vector<aiMesh*>& meshes) const;
+
     static QString getImportExtensions();
     static QString getExportExtensions();
 
@@ -0,0 +1,131 @@
+#ifndef STREAMING_DECIMATOR_HPP
+#define STREAMING_DECIMATOR_HPP
+
+#include <vector>
+#include <atomic>
+
+#include <QObject>
+#include <QMutex>
+
+#include "mesh_decimator.hpp"
+#include "mesh_index.hpp"
+
+struct aiMesh;
+
+/*!
+ * \brief decimates a large mesh cluster by cluster within a memory budget
+ *
+ * The faces are partitioned spatially (median splits along the longest axis) until the Mesh and MeshDecimator data
+ * of every cluster fit into the budget. Only one cluster is held in these structures at a time, the rest of the mesh
+ * stays in its compact imported form. Vertices shared by several clusters are locked, so that the decimated clusters
+ * can be stitched back together without cracks. The cut is a boundary of every cluster, so the boundary quadrics of
+ * MeshDecimator keep the vertices next to it from drifting away.
+ */
+class StreamingDecimator : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Cluster
+    {
+        std::size_t m_firstFace; // range in m_faceOrder
+        std::size_t m_faceCount;
+    };
+
+    const aiMesh* m_mesh;
+    unsigned int m_targetFaceCount;
+    std::size_t m_memoryBudget;
+
+    MeshDecimator::Strategy m_strategy;
+    MeshDecimator::Precision m_precision;
+    MeshDecimator::Solver m_solver;
+
+    std::vector<unsigned int> m_faceOrder; // imported faces, grouped by cluster
+    std::vector<Cluster> m_clusters;
+    std::vector<bool> m_lockedVertices; // indexed by imported vertex: vertex is shared by several clusters
+    std::vector<mesh_index> m_localVertices; // scratch buffer: index of every imported vertex in the current cluster
+
+    // stitched result
+    std::vector<glm::vec3> m_positions, m_normals;
+    std::vector<unsigned int> m_indices;
+    std::vector<mesh_index> m_outputVertices; // output index of every locked vertex (invalid until it is first stitched)
+
+    DecimationStats m_stats;
+
+    std::atomic<bool> m_abort;
+    std::size_t m_finishedFaces; // imported faces of all clusters which are done
+    std::atomic<float> m_progress;
+
+    QMutex m_mutex; // guards m_activeDecimator
+    MeshDecimator* m_activeDecimator;
+
+    StreamingDecimator(const StreamingDecimator& other) = delete;
+    StreamingDecimator& operator=(const StreamingDecimator& other) = delete;
+
+    glm::vec3 faceCenter(unsigned int f) const;
+    void partition();
+    void lockSharedVertices();
+
+    void decimateCluster(const Cluster& cluster);
+    void stitch(const Mesh& mesh, const std::vector<unsigned int>& clusterVertices);
+
+public:
+    /*!
+     * \brief creates a decimator for an imported mesh. the mesh must consist of triangles and have normals
+     * \param memoryBudget approximate number of bytes available for the data of one cluster
+     */
+    StreamingDecimator(const aiMesh* mesh, unsigned int targetFaceCount, std::size_t memoryBudget);
+    ~StreamingDecimator();
+
+    /*!
+     * \brief number of clusters the mesh was partitioned into (valid after start() has returned)
+     */
+    unsigned int clusterCount() const { return m_clusters.size(); }
+
+    /*!
+     * \brief measurements of all clusters combined (valid after start() has returned)
+     */
+    const DecimationStats& stats() const { return m_stats; }
+
+    MeshDecimator::Strategy strategy() const { return m_strategy; }
+    MeshDecimator::Precision precision() const { return m_precision; }
+    MeshDecimator::Solver solver() const { return m_solver; }
+
+    /*!
+     * \brief sets the collapse order of the cluster decimators (see MeshDecimator::setStrategy)
+     */
+    void setStrategy(MeshDecimator::Strategy strategy) { m_strategy = strategy; }
+
+    /*!
+     * \brief sets the quadric precision of the cluster decimators (see MeshDecimator::setPrecision)
+     */
+    void setPrecision(MeshDecimator::Precision precision) { m_precision = precision; }
+
+    /*!
+     * \brief sets the solver of the cluster decimators (see MeshDecimator::setSolver)
+     */
+    void setSolver(MeshDecimator::Solver solver) { m_solver = solver; }
+
+    unsigned int faceCount() const { return m_indices.size() / 3; }
+    unsigned int vertexCount() const { return m_positions.size(); }
+
+    /*!
+     * \brief creates an exportable copy of the stitched result (valid after start() has returned)
+     */
+    aiMesh* makeExportMesh() const;
+
+    float progress() const;
+    bool isAborting() const;
+
+public slots:
+    void start();
+    void abort();
+
+signals:
+    void finished();
+    void progressChanged(float value);
+    void error(QString msg);
+    void statsAvailable(DecimationStats stats);
+};
+
+#endif // STREAMING_DECIMATOR_HPP
@@ -3,8 +3,11 @@
 
 #include <utility>
 #include <array>
+#include <functional>
 #include "glm/glm.hpp"
 
+class QElapsedTimer;
+
 /*!
  * \brief hash combining function
  * (implementation is based on boost: http://www.boost.org/doc/libs/1_53_0/doc/html/hash/reference.html#boost.hash_combine)
@@ -27,6 +30,11 @@ inline float triangleArea(const glm::vec3& p0, const glm::vec3& p1, const glm::v
     return glm::length(triangleCross(p0, p1, p2)) * 0.5f;
 }
 
+/*!
+ * \brief returns the time since the last call (or since the timer was started) in milliseconds and restarts the timer
+ */
+double elapsedMs(QElapsedTimer& timer);
+
 namespace std
 {
     template<typename T, typename U>
@@ -43,43 +51,93 @@ namespace std
     };
 }
 
-struct sym_mat3
+/*!
+ * \brief quadrics whose matrix has a smaller determinant (in absolute value) are considered singular by BasicQuadric::optimum
+ */
+const float quadric_min_det(0.001f);
+
+/*!
+ * \brief eigenvalues smaller than this fraction of the largest one are treated as zero by BasicQuadric::optimumPseudoInverse
+ */
+const double quadric_rel_tolerance(1e-3);
+
+template<typename T>
+struct basic_sym_mat3
 {
-    std::array<float, 6> m_data;
+    std::array<T, 6> m_data;
+
+    basic_sym_mat3();
+    basic_sym_mat3(T m11, T m12, T m13, T m22, T m23, T m33);
 
-    sym_mat3();
-    sym_mat3(float m11, float m12, float m13, float m22, float m23, float m33);
+    template<typename U>
+    explicit basic_sym_mat3(const basic_sym_mat3<U>& other)
+    {
+        for (std::size_t i = 0; i < m_data.size(); ++i) {
+            m_data[i] = T(other.m_data[i]);
+        }
+    }
 
-    sym_mat3& operator+=(const sym_mat3& other);
-    sym_mat3 operator+(const sym_mat3& other) const;
+    basic_sym_mat3& operator+=(const basic_sym_mat3& other);
+    basic_sym_mat3 operator+(const basic_sym_mat3& other) const;
 
-    sym_mat3& operator*=(float factor);
-    sym_mat3 operator*(float factor) const;
+    basic_sym_mat3& operator*=(T factor);
+    basic_sym_mat3 operator*(T factor) const;
 
-    glm::vec3 operator*(const glm::vec3& v) const;
+    glm::tvec3<T> operator*(const glm::tvec3<T>& v) const;
 
-    explicit operator glm::mat3() const;
+    explicit operator glm::tmat3x3<T>() const;
 };
 
-struct Quadric
+typedef basic_sym_mat3<float> sym_mat3;
+typedef basic_sym_mat3<double> sym_dmat3;
+
+/*!
+ * \brief computes the eigenvalues and (orthonormal) eigenvectors of a symmetric matrix using the cyclic Jacobi method
+ */
+template<typename T>
+void symmetricEigen(const basic_sym_mat3<T>& A, T* eigenvalues, glm::tvec3<T>* eigenvectors);
+
+template<typename T>
+struct BasicQuadric
 {
-    sym_mat3 m_A;
-    glm::vec3 m_b;
-    float m_c;
+    typedef glm::tvec3<T> vec_type;
+
+    basic_sym_mat3<T> m_A;
+    vec_type m_b;
+    T m_c;
 
-    Quadric();
-    Quadric(const glm::vec3& n, float d);
-    Quadric(const glm::vec3& n, const glm::vec3& p);
+    BasicQuadric();
+    BasicQuadric(const vec_type& n, T d);
+    BasicQuadric(const vec_type& n, const vec_type& p);
 
-    Quadric& operator+=(const Quadric& other);
-    Quadric operator+(const Quadric& other) const;
+    template<typename U>
+    explicit BasicQuadric(const BasicQuadric<U>& other) : m_A(other.m_A), m_b(other.m_b), m_c(T(other.m_c)) { }
 
-    Quadric& operator*=(float factor);
-    Quadric operator*(float factor) const;
+    BasicQuadric& operator+=(const BasicQuadric& other);
+    BasicQuadric operator+(const BasicQuadric& other) const;
 
-    float operator()(const glm::vec3& v) const;
+    BasicQuadric& operator*=(T factor);
+    BasicQuadric operator*(T factor) const;
 
-    bool optimum(glm::vec3* v, float* cost) const;
+    T operator()(const vec_type& v) const;
+
+    /*!
+     * \brief computes the position with minimal error by inverting A
+     * \return false if A is singular or poorly conditioned (see quadric_min_det)
+     */
+    bool optimum(vec_type* v, T* cost) const;
+
+    /*!
+     * \brief computes the position with minimal error using the pseudo-inverse of A. this always succeeds
+     *
+     * Directions in which the error is (almost) constant are ignored, so in these directions the result stays as close to
+     * center as possible. Since the tolerance is relative to the largest eigenvalue of A, the result does not depend
+     * on the scale of the model.
+     */
+    void optimumPseudoInverse(const vec_type& center, vec_type* v, T* cost) const;
 };
 
+typedef BasicQuadric<float> Quadric;
+typedef BasicQuadric<double> QuadricD;
+
 #endif // UTIL_HPP
@@ -0,0 +1,91 @@
+#ifndef VERTEX_CLUSTERER_HPP
+#define VERTEX_CLUSTERER_HPP
+
+#include <vector>
+#include <atomic>
+
+#include <QObject>
+
+#include "decimation_stats.hpp"
+#include "mesh_index.hpp"
+#include "glm/glm.hpp"
+
+class Mesh;
+
+/*!
+ * \brief fast simplification by vertex clustering on a uniform grid, for coarse levels of detail
+ *
+ * All vertices within a grid cell are merged into one representative, which is placed at the minimum of the summed
+ * face quadrics of the cell (or at the mean position of its vertices if that quadric is singular). Faces whose
+ * corners end up in fewer than three cells are dropped. The run time is linear in the size of the mesh, but the
+ * result does not preserve topology and is much coarser in quality than the output of MeshDecimator.
+ *
+ * Provides the same slots and signals as MeshDecimator, so both can be run the same way.
+ */
+class VertexClusterer : public QObject
+{
+    Q_OBJECT
+
+private:
+    Mesh* m_mesh;
+    unsigned int m_resolution;
+
+    std::atomic<bool> m_abort;
+    std::atomic<float> m_progress;
+    DecimationStats m_stats;
+
+    // grid
+    glm::vec3 m_gridOrigin;
+    float m_cellSize;
+    unsigned int m_gridSize[3];
+
+    std::vector<unsigned int> m_vertexCells; // cell of every vertex
+    std::vector<mesh_index> m_vertexClusters; // cluster of every vertex
+    std::vector<mesh_index> m_clusterOffsets, m_clusterMembers; // vertices of cluster c: m_clusterMembers[m_clusterOffsets[c]] to m_clusterMembers[m_clusterOffsets[c+1]-1]
+    std::vector<glm::vec3> m_clusterPositions;
+
+    VertexClusterer(const VertexClusterer& other) = delete;
+    VertexClusterer& operator=(const VertexClusterer& other) = delete;
+
+    void setProgress(float value);
+
+    void initGrid();
+    void assignClusters();
+    void placeRepresentatives();
+    void rebuildMesh();
+
+public:
+    /*!
+     * \param resolution number of grid cells along the longest side of the bounding box of the mesh
+     */
+    VertexClusterer(Mesh* mesh, unsigned int resolution);
+    ~VertexClusterer();
+
+    unsigned int resolution() const { return m_resolution; }
+
+    /*!
+     * \brief number of occupied grid cells (valid after start() has returned)
+     */
+    unsigned int clusterCount() const { return m_clusterPositions.size(); }
+
+    /*!
+     * \brief measurements of the last run (valid after start() has returned). the grid and representatives are counted
+     * as m_computeQuadricsMs, building the new mesh as m_cleanupMs
+     */
+    const DecimationStats& stats() const { return m_stats; }
+
+    float progress() const;
+    bool isAborting() const;
+
+public slots:
+    void start();
+    void abort();
+
+signals:
+    void finished();
+    void progressChanged(float value);
+    void error(QString msg);
+    void statsAvailable(DecimationStats stats);
+};
+
+#endif // VERTEX_CLUSTERER_HPP
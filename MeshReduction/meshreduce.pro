@@ -0,0 +1,13 @@
+TEMPLATE = app
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+DEFINES += QT_DLL
+
+TARGET = meshreduce
+
+include(common.pri)
+include(MeshReductionCore.pri)
+
+SOURCES += \
+    $$PWD/src/meshreduce.cpp
@@ -0,0 +1,106 @@
+#include "decimation_stats.hpp"
+
+#include <algorithm>
+
+DecimationStats::DecimationStats() :
+    m_computeQuadricsMs(0.0), m_initPairsMs(0.0), m_initQueueMs(0.0), m_iterateMs(0.0), m_cleanupMs(0.0), m_normalsMs(0.0),
+    m_queueMs(0.0), m_queueTimed(false),
+    m_facesBefore(0), m_facesAfter(0), m_targetFaces(0),
+    m_collapses(0), m_stalePairs(0), m_outdatedEntries(0), m_rejectedTopology(0), m_rejectedValency(0), m_rejectedFaceFlip(0),
+    m_requeuedPairs(0), m_retryRounds(0), m_iterateAllocations(0), m_allocationsCounted(false), m_peakMemoryBytes(0) { }
+
+double DecimationStats::totalMs() const
+{
+    return m_computeQuadricsMs + m_initPairsMs + m_initQueueMs + m_iterateMs + m_cleanupMs + m_normalsMs;
+}
+
+unsigned long long DecimationStats::rejections() const
+{
+    return m_rejectedTopology + m_rejectedValency + m_rejectedFaceFlip;
+}
+
+DecimationStats &DecimationStats::operator+=(const DecimationStats &other)
+{
+    m_computeQuadricsMs += other.m_computeQuadricsMs;
+    m_initPairsMs += other.m_initPairsMs;
+    m_initQueueMs += other.m_initQueueMs;
+    m_iterateMs += other.m_iterateMs;
+    m_cleanupMs += other.m_cleanupMs;
+    m_normalsMs += other.m_normalsMs;
+
+    m_queueMs += other.m_queueMs;
+    m_queueTimed = m_queueTimed || other.m_queueTimed;
+
+    m_facesBefore += other.m_facesBefore;
+    m_facesAfter += other.m_facesAfter;
+    m_targetFaces += other.m_targetFaces;
+
+    m_collapses += other.m_collapses;
+    m_stalePairs += other.m_stalePairs;
+    m_outdatedEntries += other.m_outdatedEntries;
+    m_rejectedTopology += other.m_rejectedTopology;
+    m_rejectedValency += other.m_rejectedValency;
+    m_rejectedFaceFlip += other.m_rejectedFaceFlip;
+    m_requeuedPairs += other.m_requeuedPairs;
+    m_retryRounds += other.m_retryRounds;
+
+    m_iterateAllocations += other.m_iterateAllocations;
+    m_allocationsCounted = m_allocationsCounted || other.m_allocationsCounted;
+
+    m_peakMemoryBytes = std::max(m_peakMemoryBytes, other.m_peakMemoryBytes);
+
+    return *this;
+}
+
+QJsonObject DecimationStats::toJson() const
+{
+    // QJsonValue has no integer constructor for 64 bit values in Qt 5.6, counts are stored as doubles
+    QJsonObject result;
+
+    result["compute_quadrics_ms"] = m_computeQuadricsMs;
+    result["init_pairs_ms"] = m_initPairsMs;
+    result["init_queue_ms"] = m_initQueueMs;
+    result["iterate_ms"] = m_iterateMs;
+    result["cleanup_data_ms"] = m_cleanupMs;
+    result["recompute_normals_ms"] = m_normalsMs;
+
+    if (m_queueTimed)
+        result["queue_ms"] = m_queueMs;
+
+    result["faces_before"] = double(m_facesBefore);
+    result["faces_after"] = double(m_facesAfter);
+    result["faces_target"] = double(m_targetFaces);
+
+    result["collapses"] = double(m_collapses);
+    result["stale_pairs"] = double(m_stalePairs);
+    result["outdated_entries"] = double(m_outdatedEntries);
+
+    QJsonObject rejected;
+    rejected["topology"] = double(m_rejectedTopology);
+    rejected["valency"] = double(m_rejectedValency);
+    rejected["face_flip"] = double(m_rejectedFaceFlip);
+    result["rejected"] = rejected;
+
+    result["requeued_pairs"] = double(m_requeuedPairs);
+    result["retry_rounds"] = double(m_retryRounds);
+
+    if (m_allocationsCounted)
+        result["iterate_allocations"] = double(m_iterateAllocations);
+
+    result["peak_memory_bytes"] = double(m_peakMemoryBytes);
+
+    return result;
+}
+
+QString DecimationStats::summary() const
+{
+    return QString("%1 ms, %2 collapses, rejected %3 (topology %4, valency %5, face flip %6), %7 retry rounds, peak memory %8 MiB")
+            .arg(totalMs(), 0, 'f', 0)
+            .arg(m_collapses)
+            .arg(rejections())
+            .arg(m_rejectedTopology)
+            .arg(m_rejectedValency)
+            .arg(m_rejectedFaceFlip)
+            .arg(m_retryRounds)
+            .arg(double(m_peakMemoryBytes) / (1024.0 * 1024.0), 0, 'f', 1);
+}
@@ -0,0 +1,31 @@
+#include "memory_usage.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+std::size_t peakMemoryUsage()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+
+    return 0;
+#elif defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#if defined(__APPLE__)
+    return std::size_t(usage.ru_maxrss); // bytes
+#else
+    return std::size_t(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
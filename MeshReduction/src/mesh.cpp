@@ -1,24 +1,33 @@
 #include "mesh.hpp"
+#include "parallel.hpp"
 
-#include <QOpenGLFunctions>
 #include <QtDebug>
-#include <QMatrix4x4>
+#include <QThreadStorage>
 #include <assimp/mesh.h>
 
 #include <assert.h>
 
 #include <limits>
-#include <unordered_map>
+#include <cstring>
 #include <algorithm>
 #include <array>
 #include <set>
 #include <unordered_set>
 
-Mesh::Mesh(const aiMesh *mesh) : m_importedMesh(mesh)
+Mesh::Mesh(const aiMesh *mesh) : m_importedMesh(mesh), m_version(0), m_boundaryBegin(0)
 {
     processImportedMesh();
 }
 
+Mesh::Mesh(const Mesh &other) : m_importedMesh(other.m_importedMesh),
+    m_importedFaceCount(other.m_importedFaceCount), m_importedHalfedgeCount(other.m_importedHalfedgeCount),
+    m_importedVertexCount(other.m_importedVertexCount), m_vertexCount(other.m_vertexCount.load()),
+    m_version(other.m_version.load()),
+    m_edges(other.m_edges), m_boundaryBegin(other.m_boundaryBegin), m_vertexEdges(other.m_vertexEdges), m_vertexSources(other.m_vertexSources),
+    m_vertexValencies(other.m_vertexValencies), m_vertexVersions(other.m_vertexVersions), m_faceNormals(other.m_faceNormals), m_faceAreas(other.m_faceAreas),
+    m_vertexPositions(other.m_vertexPositions), m_vertexNormals(other.m_vertexNormals)
+{ }
+
 Mesh::~Mesh() { }
 
 QString Mesh::name() const { return m_importedMesh->mName.C_Str(); }
@@ -39,76 +48,125 @@ void Mesh::processImportedMesh()
     m_vertexPositions.assign(vData, vData + vCount);
     m_vertexNormals.assign(nData, nData + vCount);
 
-    // build winged halfedge data structure
-    m_edges.clear();
-    m_faceEdges.clear();
-    m_vertexEdges.resize(m_vertexPositions.size());
-
-    // helper data structure: store start and end vertices for every halfedge
-    std::unordered_map<std::pair<mesh_index, mesh_index>, mesh_index> edgesFromVertex;
+    m_vertexSources.resize(vCount);
+    for (mesh_index v = 0; v < vCount; ++v) {
+        m_vertexSources[v] = v;
+    }
 
-    // first pass: create faces and halfedges
-    for (unsigned int i = 0, f = 0; i < m_importedMesh->mNumFaces; ++i) {
+    buildConnectivity(m_importedMesh->mNumFaces, [this] (unsigned int i) {
         const aiFace& face = m_importedMesh->mFaces[i];
 
         assert(face.mNumIndices == 3); // all faces must be triangles. if this assertion fails, something must have gone wrong with assimp's post-processing
 
-        mesh_index v0 = face.mIndices[0];
-        mesh_index v1 = face.mIndices[1];
-        mesh_index v2 = face.mIndices[2];
+        return static_cast<const unsigned int*>(face.mIndices);
+    }, false);
+
+    m_importedFaceCount = faceCount();
+    m_importedHalfedgeCount = halfedgeCount();
+    m_importedVertexCount = vertexCount();
+}
+
+void Mesh::assignTriangles(std::vector<glm::vec3> positions, std::vector<glm::vec3> normals, std::vector<mesh_index> sources,
+                           const std::vector<unsigned int>& indices)
+{
+    m_indices.clear();
+
+    m_vertexPositions = std::move(positions);
+    m_vertexNormals = std::move(normals);
+    m_vertexSources = std::move(sources);
 
-        mesh_index e0 = f*3 + 0;
-        mesh_index e1 = f*3 + 1;
-        mesh_index e2 = f*3 + 2;
+    buildConnectivity(indices.size() / 3, [&indices] (unsigned int i) {
+        return indices.data() + i*3;
+    }, true);
+}
 
-        m_faceEdges.push_back(e0);
+void Mesh::buildConnectivity(unsigned int numFaces, const std::function<const unsigned int*(unsigned int)>& faceIndices,
+                             bool splitClosedFans)
+{
+    unsigned int vCount = m_vertexPositions.size();
 
-        m_vertexEdges[v0] = e0;
-        m_vertexEdges[v1] = e1;
-        m_vertexEdges[v2] = e2;
+    // build halfedge data structure
+    m_edges.clear();
+    m_vertexEdges.clear();
+    m_vertexEdges.resize(vCount);
 
-        m_edges.push_back({v0, f, inv_index, e1, e2});
-        m_edges.push_back({v1, f, inv_index, e2, e0});
-        m_edges.push_back({v2, f, inv_index, e0, e1});
+    m_edges.reserve(numFaces * 3);
 
-        auto r0 = edgesFromVertex.emplace(std::make_pair(v0, v1), e0);
-        auto r1 = edgesFromVertex.emplace(std::make_pair(v1, v2), e1);
-        auto r2 = edgesFromVertex.emplace(std::make_pair(v2, v0), e2);
+    // first pass: create faces and halfedges
+    for (unsigned int f = 0; f < numFaces; ++f) {
+        const unsigned int* face = faceIndices(f);
 
-        assert(r0.second);
-        assert(r1.second);
-        assert(r2.second);
+        mesh_index v0 = face[0];
+        mesh_index v1 = face[1];
+        mesh_index v2 = face[2];
 
-        ++f;
-    }
+        m_vertexEdges[v0] = f*3 + 0;
+        m_vertexEdges[v1] = f*3 + 1;
+        m_vertexEdges[v2] = f*3 + 2;
 
-    std::vector<mesh_index> nonManifold;
+        m_edges.push_back({v0, inv_index});
+        m_edges.push_back({v1, inv_index});
+        m_edges.push_back({v2, inv_index});
+    }
 
-    // second pass: find opposite halfedges
     mesh_index edgeCount = m_edges.size();
-    for (mesh_index e0 = 0; e0 < edgeCount; ++e0) {
-        mesh_index v0 = eVertex(e0), v1 = eVertex(eNext(e0));
+    m_boundaryBegin = edgeCount;
 
-        // find halfedge with reversed start and end vertices
-        auto it = edgesFromVertex.find(std::make_pair(v1, v0));
+    // helper data structure: outgoing halfedges of every vertex in ascending order (outEdges[outOffsets[v]] to outEdges[outOffsets[v+1]-1])
+    std::vector<mesh_index> outOffsets(vCount + 1, 0);
+    std::vector<mesh_index> outEdges(edgeCount);
 
-        mesh_index e1 = inv_index;
-        if (it != edgesFromVertex.end()) {
-            e1 = it->second;
+    for (mesh_index e = 0; e < edgeCount; ++e) {
+        ++outOffsets[eVertex(e) + 1];
+    }
 
-        } else { // halfedge is boundary! create new opposite
-            e1 = m_edges.size();
-            m_edges.push_back({v1, inv_index, e0, inv_index, inv_index});
+    for (mesh_index v = 0; v < vCount; ++v) {
+        outOffsets[v + 1] += outOffsets[v];
+    }
 
-            mesh_index be = vEdge(v1);
-            if (eIsBoundary(be)) { // vertex is already boundary? => non-manifold geometry!
-                nonManifold.push_back(e1);
+    {
+        std::vector<mesh_index> outEnds(outOffsets.begin(), outOffsets.end() - 1);
+        for (mesh_index e = 0; e < edgeCount; ++e) {
+            outEdges[outEnds[eVertex(e)]++] = e;
+        }
+    }
+
+    // second pass: find opposite halfedges. if there are several candidates (non-manifold edge), take the first one
+    parallel_for(edgeCount, [&] (std::size_t begin, std::size_t end) {
+        for (mesh_index e0 = begin; e0 < end; ++e0) {
+            mesh_index v0 = eVertex(e0), v1 = eVertex(eNext(e0));
 
-            } else {
-                // satisfy the condition that boundary vertices always reference their boundary edge
-                m_vertexEdges[v1] = e1;
+            // find halfedge with reversed start and end vertices
+            for (mesh_index i = outOffsets[v1]; i < outOffsets[v1 + 1]; ++i) {
+                mesh_index e1 = outEdges[i];
+                if (eVertex(eNext(e1)) == v0) {
+                    m_edges[e0].m_opposite = e1;
+                    break;
+                }
             }
         }
+    });
+
+    std::vector<mesh_index> nonManifold;
+
+    // the remaining halfedges are boundary! create new opposites (in order, since the boundary edges of the vertices depend on it)
+    for (mesh_index e0 = 0; e0 < edgeCount; ++e0) {
+        if (is_valid(eOpposite(e0)))
+            continue;
+
+        mesh_index v1 = eVertex(eNext(e0));
+
+        mesh_index e1 = m_edges.size();
+        m_edges.push_back({v1, e0});
+
+        mesh_index be = vEdge(v1);
+        if (eIsBoundary(be)) { // vertex is already boundary? => non-manifold geometry!
+            nonManifold.push_back(e1);
+
+        } else {
+            // satisfy the condition that boundary vertices always reference their boundary edge
+            m_vertexEdges[v1] = e1;
+        }
 
         // connect opposite halfedges
         m_edges[e0].m_opposite = e1;
@@ -127,11 +185,59 @@ void Mesh::processImportedMesh()
         }
     }
 
-    m_vertexCount = m_vertexEdges.size();
+    // fourth pass (only for rebuilt meshes, imported connectivity stays untouched): vertices can't have multiple
+    // closed fans either (e.g. two cones touching at their tips, as left behind by vertex clustering)!
+    // every interior halfedge which can't be reached from the vertex edge of its vertex starts another fan
+    if (splitClosedFans) {
+        std::vector<unsigned char> reached(edgeCount, 0);
+        mesh_index originalVertexCount = m_vertexEdges.size();
 
-    m_importedFaceCount = faceCount();
-    m_importedHalfedgeCount = halfedgeCount();
-    m_importedVertexCount = vertexCount();
+        for (mesh_index v = 0; v < originalVertexCount; ++v) {
+            if (eVertex(vEdge(v)) != v) // vertex is not used by any face
+                continue;
+
+            for (mesh_index e : vEdgeFan(v)) {
+                if (e < edgeCount)
+                    reached[e] = 1;
+            }
+        }
+
+        for (mesh_index e = 0; e < edgeCount; ++e) {
+            if (reached[e])
+                continue;
+
+            mesh_index nv = duplicateVertex(eVertex(e));
+
+            m_vertexEdges[nv] = e;
+
+            for (mesh_index fe : eFan(e)) {
+                m_edges[fe].m_vertex = nv;
+                if (fe < edgeCount)
+                    reached[fe] = 1;
+            }
+        }
+    }
+
+    // every neighbour is the end of one outgoing halfedge (on the boundary, the boundary halfedge is one of them)
+    m_vertexValencies.assign(m_vertexEdges.size(), 0);
+
+    for (const Halfedge& edge : m_edges) {
+        ++m_vertexValencies[edge.m_vertex];
+    }
+
+    m_vertexVersions.assign(m_vertexEdges.size(), 0);
+    m_version = 0;
+
+    m_faceNormals.resize(numFaces);
+    m_faceAreas.resize(numFaces);
+
+    parallel_for(numFaces, [this] (std::size_t begin, std::size_t end) {
+        for (mesh_index f = begin; f < end; ++f) {
+            updateFaceGeometry(f);
+        }
+    });
+
+    m_vertexCount = m_vertexEdges.size();
 }
 
 aiMesh *Mesh::makeExportMesh() const
@@ -175,10 +281,10 @@ aiMesh *Mesh::makeExportMesh() const
 void Mesh::computeIndices()
 {
     m_indices.clear();
-    m_indices.reserve(m_faceEdges.size() * 3);
+    m_indices.reserve(faceCount() * 3);
 
-    for (unsigned int i = 0; i < m_faceEdges.size(); ++i) {
-        mesh_index e0 = m_faceEdges[i];
+    for (unsigned int i = 0; i < faceCount(); ++i) {
+        mesh_index e0 = fEdge(i);
         if (!is_valid(e0)) continue;
 
         mesh_index e1 = eNext(e0), e2 = eNext(e1);
@@ -219,29 +325,25 @@ mesh_index Mesh::vConnectingEdge(mesh_index v, mesh_index v1) const
     return inv_index;
 }
 
-unsigned int Mesh::vValency(mesh_index v) const
+Mesh::VertexMarks& Mesh::localVertexMarks()
 {
-    mesh_index e = vEdge(v);
-    return std::distance(eFanBegin(e), eFanEnd(e));
+    static QThreadStorage<VertexMarks> vertexMarks;
+    return vertexMarks.localData();
 }
 
-glm::vec3 Mesh::fNormal(mesh_index f) const
+void Mesh::updateFaceGeometry(mesh_index f)
 {
-    mesh_index e0 = fEdge(f), e1 = eNext(e0), e2 = eNext(e1);
-    return triangleNormal(eStartPos(e0), eStartPos(e1), eStartPos(e2));
-}
+    glm::vec3 c = triangleCross(eStartPos(f*3 + 0), eStartPos(f*3 + 1), eStartPos(f*3 + 2));
 
-float Mesh::fArea(mesh_index f) const
-{
-    mesh_index e0 = fEdge(f), e1 = eNext(e0), e2 = eNext(e1);
-    return triangleArea(eStartPos(e0), eStartPos(e1), eStartPos(e2));
+    m_faceNormals[f] = glm::normalize(c);
+    m_faceAreas[f] = glm::length(c) * 0.5f;
 }
 
-bool Mesh::isPairContractable(mesh_index v0, mesh_index v1, const glm::vec3& newPos) const
+ContractionResult Mesh::checkPairContraction(mesh_index v0, mesh_index v1, const glm::vec3& newPos) const
 {
     mesh_index e0 = vConnectingEdge(v0, v1);
     if (!is_valid(e0)) {
-        return false;
+        return RejectedTopology;
     }
 
     mesh_index e0n = eNext(e0);
@@ -255,55 +357,70 @@ bool Mesh::isPairContractable(mesh_index v0, mesh_index v1, const glm::vec3& new
     if (vIsBoundary(v0)) ++bc;
     if (vIsBoundary(v1)) ++bc;
 
-    unsigned int vCount = m_vertexCount;
+    unsigned int vCount = m_vertexCount.load(std::memory_order_relaxed);
 
     if (bc == 0) { // neither v0 nor v1 are boundary
         if (vCount <= 4)
             // mesh contains no more than 4 vertices: edge is not collapsible!
-            return false;
+            return RejectedTopology;
 
     } else if (bc == 1) { // either v0 or v1 are boundary
         if (vCount <= 3)
             // mesh contains no more than 3 vertices: edge is not collapsible!
-            return false;
+            return RejectedTopology;
 
     } else { // both v0 and v1 are boundary
         if (!(eIsBoundary(e0) || eIsBoundary(e1)))
             // edge between v0 and v1 is not boundary: edge is not collapsible!
-            return false;
+            return RejectedTopology;
     }
 
     unsigned int val0 = vValency(v0), val1 = vValency(v1);
     if (val0 <= 3 && val1 <= 3) {
         // this test prevents loose parts of the mesh from forming degenerate triangles
-        return false;
+        return RejectedValency;
     }
 
 
-    // iterate over all neighbours of v0
-    for (mesh_index e : vEdgeFan(v0)) {
-        mesh_index v2 = eEndVertex(e); // v2 is a neighbour of v0
+    // iterate over all shared neighbours of v0 and v1
+    ContractionResult result = Contractable;
+    unsigned int sharedCount = 0;
 
-        if (vIsConnected(v1, v2)) { // if v2 is also connected to v1, it is a shared neighbour (which we need to check)
+    vForEachSharedNeighbour(v0, v1, [&] (mesh_index v2) {
+        ++sharedCount;
 
-            if (vIsBoundary(v2)) { // is v2 a boundary vertex?
+        if (vIsBoundary(v2)) { // is v2 a boundary vertex?
 
-                mesh_index ve = vEdge(v2); // since boundary vertices always reference their boundary edge, we can simply do this
-                mesh_index endVertex = eEndVertex(ve);
+            mesh_index ve = vEdge(v2); // since boundary vertices always reference their boundary edge, we can simply do this
+            mesh_index endVertex = eEndVertex(ve);
 
-                if (((endVertex == v0) && eIsBoundary(e0)) || ((endVertex == v1) && eIsBoundary(e1)))
-                    // if the boundary edge of v2 points to v0 and e0 is also a boundary edge, the vertices v0, v1 and v2 do not form a triangle
-                    // the same applies to v1 and e1 analogously
+            if (((endVertex == v0) && eIsBoundary(e0)) || ((endVertex == v1) && eIsBoundary(e1))) {
+                // if the boundary edge of v2 points to v0 and e0 is also a boundary edge, the vertices v0, v1 and v2 do not form a triangle
+                // the same applies to v1 and e1 analogously
 
-                    // the shared neighbour v2 does not form a triangle with v0 and v1: edge not collapsible!
-                    return false;
+                // the shared neighbour v2 does not form a triangle with v0 and v1: edge not collapsible!
+                result = RejectedTopology;
+                return false;
             }
+        }
 
-            if (vValency(v2) <= 3)
-                // the valency of the shared neighbour v2 is not greater than 3: edge not collapsible!
-                return false;
+        if (vValency(v2) <= 3) {
+            // the valency of the shared neighbour v2 is not greater than 3: edge not collapsible!
+            result = RejectedValency;
+            return false;
         }
-    }
+
+        return true;
+    });
+
+    if (result != Contractable)
+        return result;
+
+    unsigned int adjacentFaces = (eIsBoundary(e0) ? 0 : 1) + (eIsBoundary(e1) ? 0 : 1);
+    if (sharedCount != adjacentFaces)
+        // link condition: v0 and v1 may only share the opposite corners of their faces. otherwise, the collapse would
+        // pinch the mesh into a non-manifold edge: edge not collapsible!
+        return RejectedTopology;
 
     // phase 2: geometric tests
 
@@ -318,13 +435,13 @@ bool Mesh::isPairContractable(mesh_index v0, mesh_index v1, const glm::vec3& new
 
                 if (glm::dot(oldNormal, newNormal) < 0.0f)
                     // pair contraction causes adjacent face to flip: edge not collapsible!
-                    return false;
+                    return RejectedFaceFlip;
             }
         }
     }
 
     // all tests passed: edge is collapsible!
-    return true;
+    return Contractable;
 }
 
 unsigned int Mesh::collapseEdge(mesh_index e, const glm::vec3& newPos)
@@ -347,6 +464,19 @@ unsigned int Mesh::collapseEdge(mesh_index e, const glm::vec3& newPos)
         nve = eNext(eOpposite(ve0));
     }
 
+    // v0 takes over the neighbours of v1, except for itself and the shared neighbours. every shared neighbour loses
+    // one of its edges to v0 and v1, whether it forms a removed face with them or not
+    unsigned int sharedCount = 0;
+
+    vForEachSharedNeighbour(v0, v1, [this, &sharedCount] (mesh_index v2) {
+        ++sharedCount;
+        --m_vertexValencies[v2];
+        return true;
+    });
+
+    m_vertexValencies[v0] += m_vertexValencies[v1] - 2 - sharedCount;
+    m_vertexValencies[v1] = 0;
+
     m_vertexEdges[v0] = nve;
     m_vertexPositions[v0] = newPos;
 
@@ -372,9 +502,7 @@ unsigned int Mesh::collapseEdge(mesh_index e, const glm::vec3& newPos)
             m_edges[neo].m_opposite = peo;
 
 
-            // invalidate removed primitives to mark them for deletion
-            m_faceEdges[eFace(edge)] = inv_index;
-
+            // invalidate removed primitives to mark them for deletion. a face is invalid if its halfedges are
             m_edges[pe] = inv_edge;
             m_edges[ne] = inv_edge;
         }
@@ -385,7 +513,19 @@ unsigned int Mesh::collapseEdge(mesh_index e, const glm::vec3& newPos)
     }
 
     m_vertexEdges[v1] = inv_index;
-    --m_vertexCount;
+    m_vertexCount.fetch_sub(1, std::memory_order_relaxed);
+
+    // v0 has been moved, so all faces around it have changed. the one-rings of its neighbours contain v0 now, and the
+    // valencies of the shared neighbours have changed
+    unsigned int version = m_version.fetch_add(1, std::memory_order_relaxed) + 1;
+    m_vertexVersions[v0] = version;
+
+    for (mesh_index edge : vEdgeFan(v0)) {
+        m_vertexVersions[eEndVertex(edge)] = version;
+
+        if (!eIsBoundary(edge))
+            updateFaceGeometry(eFace(edge));
+    }
 
 #if defined(_DEBUG)
     runVertexTest(v0);
@@ -407,47 +547,92 @@ mesh_index Mesh::duplicateVertex(mesh_index v)
     glm::vec3 vn = m_vertexNormals[v];
     m_vertexNormals.push_back(vn);
 
+    mesh_index vs = m_vertexSources[v];
+    m_vertexSources.push_back(vs);
+
     return nv;
 }
 
+std::unique_ptr<Mesh> Mesh::compactCopy() const
+{
+    std::unique_ptr<Mesh> copy(new Mesh(*this));
+
+    copy->cleanupData();
+    copy->recomputeNormals();
+
+    return copy;
+}
+
 void Mesh::cleanupData()
 {
-    cleanupPrimitives(m_faceEdges, [this] (mesh_index f, mesh_index l) {
-        m_faceEdges[f] = m_faceEdges[l];
-        mesh_index e0 = m_faceEdges[f], e1 = eNext(e0), e2 = eNext(e1);
-        m_edges[e0].m_face = f;
-        m_edges[e1].m_face = f;
-        m_edges[e2].m_face = f;
-    });
+    // new indices of the remaining faces, boundary halfedges and vertices. every primitive can only move to a lower
+    // index, so the data can be moved within the same containers in ascending order
+    mesh_index faceSlots = faceCount();
+    std::vector<mesh_index> faceMap(faceSlots, inv_index);
+    std::vector<mesh_index> boundaryMap(m_edges.size() - m_boundaryBegin, inv_index);
+    std::vector<mesh_index> vertexMap(m_vertexEdges.size(), inv_index);
+
+    mesh_index fc = 0, bc = 0, vc = 0;
+
+    for (mesh_index f = 0; f < faceSlots; ++f) {
+        if (!is_valid(fEdge(f)))
+            continue;
+
+        m_faceNormals[fc] = m_faceNormals[f];
+        m_faceAreas[fc] = m_faceAreas[f];
+        faceMap[f] = fc++;
+    }
 
-    cleanupPrimitives(m_edges, [this] (mesh_index e, mesh_index l) {
-        m_edges[e] = m_edges[l];
+    for (mesh_index b = 0; b < boundaryMap.size(); ++b) {
+        if (eIsValid(m_boundaryBegin + b))
+            boundaryMap[b] = bc++;
+    }
 
-        m_edges[eOpposite(e)].m_opposite = e;
-        m_edges[eNext(e)].m_previous = e;
-        m_edges[ePrev(e)].m_next = e;
+    for (mesh_index v = 0; v < vertexMap.size(); ++v) {
+        if (vIsValid(v))
+            vertexMap[v] = vc++;
+    }
 
-        mesh_index f = eFace(e);
-        if (m_faceEdges[f] == l)
-            m_faceEdges[f] = e;
+    auto edgeMap = [&] (mesh_index e) -> mesh_index {
+        if (eIsBoundary(e))
+            return fc*3 + boundaryMap[e - m_boundaryBegin];
 
-        mesh_index v = eVertex(e);
-        if (m_vertexEdges[v] == l)
-            m_vertexEdges[v] = e;
-    });
+        return faceMap[e / 3]*3 + e % 3;
+    };
 
-    cleanupPrimitives(m_vertexEdges, [this] (mesh_index v, mesh_index l) {
-        m_vertexEdges[v] = m_vertexEdges[l];
-        m_vertexPositions[v] = m_vertexPositions[l];
-        m_vertexNormals[v] = m_vertexNormals[l];
+    for (mesh_index e = 0; e < m_edges.size(); ++e) {
+        if (!eIsValid(e))
+            continue;
 
-        for (mesh_index e : vEdgeFan(v)) {
-            m_edges[e].m_vertex = v;
-        }
-    });
+        const Halfedge& edge = m_edges[e];
+        m_edges[edgeMap(e)] = { vertexMap[edge.m_vertex], edgeMap(edge.m_opposite) };
+    }
+
+    for (mesh_index v = 0; v < vertexMap.size(); ++v) {
+        if (!is_valid(vertexMap[v]))
+            continue;
+
+        mesh_index nv = vertexMap[v];
+        m_vertexEdges[nv] = edgeMap(m_vertexEdges[v]);
+        m_vertexPositions[nv] = m_vertexPositions[v];
+        m_vertexNormals[nv] = m_vertexNormals[v];
+        m_vertexSources[nv] = m_vertexSources[v];
+        m_vertexValencies[nv] = m_vertexValencies[v];
+        m_vertexVersions[nv] = m_vertexVersions[v];
+    }
+
+    m_edges.resize(fc*3 + bc);
+    m_boundaryBegin = fc*3;
 
-    m_vertexPositions.resize(m_vertexEdges.size());
-    m_vertexNormals.resize(m_vertexEdges.size());
+    m_faceNormals.resize(fc);
+    m_faceAreas.resize(fc);
+
+    m_vertexEdges.resize(vc);
+    m_vertexPositions.resize(vc);
+    m_vertexNormals.resize(vc);
+    m_vertexSources.resize(vc);
+    m_vertexValencies.resize(vc);
+    m_vertexVersions.resize(vc);
 
     assert(m_vertexCount == m_vertexEdges.size());
 }
@@ -487,6 +672,10 @@ void Mesh::runVertexTest(mesh_index v)
         }
     }
 
+    if (vValency(v) != static_cast<unsigned int>(std::distance(vEdgeFanBegin(v), vEdgeFanEnd(v)))) {
+        qDebug() << "valency doesn't match:" << v;
+    }
+
     mesh_index e = vEdge(v);
 
     for (mesh_index f : vEdgeFan(v)) {
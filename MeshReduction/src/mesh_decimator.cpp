@@ -1,145 +1,908 @@
 #include "mesh_decimator.hpp"
 #include "mesh.hpp"
+#include "parallel.hpp"
+#include "memory_usage.hpp"
 
-#include <unordered_set>
+#include <algorithm>
+#include <limits>
 #include <QDebug>
 
+// number of pairs whose costs are evaluated at once
+#define PAIR_BATCH_SIZE 256
 
-MeshDecimator::MeshDecimator(Mesh *mesh, unsigned int targetFaceCount) :
-    m_mesh(mesh), m_targetFaceCount(targetFaceCount), m_abort(false), m_costComparer(m_pairs), m_pairsByCost(m_costComparer)
+// the lazy queue is compacted when it holds this many entries per vertex pair
+#define LAZY_HEAP_COMPACT_RATIO 2
+
+// number of collapses per parallel task of ParallelStrategy
+#define COLLAPSE_GRAIN_SIZE 64
+
+// number of candidates which ParallelStrategy tests at once before selecting from them
+#define SELECTION_CHUNK_SIZE 1024
+
+// defaults of the multiple choice and batched strategies
+#define DEFAULT_CANDIDATE_COUNT 8
+#define DEFAULT_BATCH_FRACTION 0.25f
+
+// progress is signalled in steps of 1% by default
+#define DEFAULT_PROGRESS_STEP 0.01f
+
+namespace
+{
+
+/*!
+ * \brief adds the lifetime of the object to a counter in milliseconds. does nothing if the counter is null
+ */
+class ScopedTimer
+{
+private:
+    double* m_ms;
+    QElapsedTimer m_timer;
+
+public:
+    explicit ScopedTimer(double* ms) : m_ms(ms) {
+        if (m_ms) m_timer.start();
+    }
+
+    ~ScopedTimer() {
+        if (m_ms) *m_ms += m_timer.nsecsElapsed() * 1e-6;
+    }
+};
+
+}
+
+
+MeshDecimator::MeshDecimator(Mesh *mesh, unsigned int targetFaceCount, QueueType queueType) :
+    m_mesh(mesh), m_targetFaceCount(targetFaceCount), m_abort(false),
+    m_progressInterval(0), m_progressStep(DEFAULT_PROGRESS_STEP), m_lastProgress(0.0f), m_queueProfiling(false), m_allocationCounter(nullptr),
+    m_strategy(GreedyStrategy), m_candidateCount(DEFAULT_CANDIDATE_COUNT), m_batchFraction(DEFAULT_BATCH_FRACTION), m_queueType(queueType),
+    m_precision(SinglePrecision), m_solver(DeterminantSolver),
+    m_costComparer(m_pairs), m_pairsByCost(m_costComparer), m_pairHeap(VertexPairHeapPosition(m_pairs)),
+    m_markEpoch(0), m_failedSamples(0)
 { }
 
 void MeshDecimator::computeQuadrics()
 {
-    m_quadrics.resize(m_mesh->vertexCount());
+    m_quadrics.clear();
+    m_doubleQuadrics.clear();
 
-    const float boundaryPenalty = 100.0f;
+    if (m_precision == DoublePrecision)
+        computeQuadrics(m_doubleQuadrics);
+    else
+        computeQuadrics(m_quadrics);
+}
 
-    // compute error quadrics (Q-matrix) for every vertex
-    for (mesh_index v = 0; v < m_quadrics.size(); ++v) {
-        glm::vec3 vpos = m_mesh->vPosition(v);
+template<typename T>
+void MeshDecimator::computeQuadrics(std::vector<BasicQuadric<T>>& quadrics)
+{
+    typedef typename BasicQuadric<T>::vec_type vec_type;
 
-        // iterate over edge fan to get all planes intersecting at v
-        for (mesh_index e : m_mesh->vEdgeFan(v)) {
-            mesh_index be = inv_index;
+    const T boundaryPenalty = T(100);
 
-            if (m_mesh->eIsBoundary(e)) {
-                be = m_mesh->eOpposite(e);
-            } else {
-                if (m_mesh->eIsBoundary(m_mesh->eOpposite(e))) {
-                    be = e;
+    // first phase: compute the plane quadric of every face once
+    std::vector<BasicQuadric<T>> faceQuadrics(m_mesh->faceCount());
+
+    parallel_for(faceQuadrics.size(), [&] (std::size_t begin, std::size_t end) {
+        for (mesh_index f = begin; f < end; ++f) {
+            vec_type n(m_mesh->fNormal(f));
+            faceQuadrics[f] = BasicQuadric<T>(n, vec_type(m_mesh->eStartPos(m_mesh->fEdge(f))));
+        }
+    });
+
+    // second phase: compute error quadrics (Q-matrix) for every vertex by summing up the quadrics of all adjacent faces
+    quadrics.assign(m_mesh->vertexCount(), BasicQuadric<T>());
+
+    parallel_for(quadrics.size(), [&] (std::size_t begin, std::size_t end) {
+        for (mesh_index v = begin; v < end; ++v) {
+            vec_type vpos(m_mesh->vPosition(v));
+            BasicQuadric<T>& Q = quadrics[v];
+
+            // iterate over edge fan to get all planes intersecting at v
+            for (mesh_index e : m_mesh->vEdgeFan(v)) {
+                mesh_index be = inv_index;
+
+                if (m_mesh->eIsBoundary(e)) {
+                    be = m_mesh->eOpposite(e);
+                } else {
+                    if (m_mesh->eIsBoundary(m_mesh->eOpposite(e))) {
+                        be = e;
+                    }
+
+                    Q += faceQuadrics[m_mesh->eFace(e)];
                 }
-                mesh_index f = m_mesh->eFace(e);
-                glm::vec3 n = m_mesh->fNormal(f);
 
-                m_quadrics[v] += Quadric(n, vpos);
+                if (is_valid(be)) { // is there a boundary edge?
+                    mesh_index of = m_mesh->eFace(be);
+                    glm::vec3 on = m_mesh->fNormal(of);
+                    glm::vec3 ev = m_mesh->eVector(be);
+
+                    // get normal of imaginary plane intersecting the edge and perpendicular to the face
+                    glm::vec3 cpn = glm::normalize(glm::cross(ev, on));
+
+                    // weight this quadric by a penalty
+                    Q += BasicQuadric<T>(vec_type(cpn), vpos) * boundaryPenalty;
+                }
             }
+        }
+    });
+}
+
+void MeshDecimator::mergeQuadrics(mesh_index v0, mesh_index v1)
+{
+    if (m_precision == DoublePrecision)
+        m_doubleQuadrics[v0] += m_doubleQuadrics[v1];
+    else
+        m_quadrics[v0] += m_quadrics[v1];
+}
 
-            if (is_valid(be)) { // is there a boundary edge?
-                mesh_index of = m_mesh->eFace(be);
-                glm::vec3 on = m_mesh->fNormal(of);
-                glm::vec3 ev = m_mesh->eVector(be);
+template<typename T>
+void MeshDecimator::evaluatePairCost(PairCandidate &pair, const std::vector<BasicQuadric<T>> &quadrics) const
+{
+    typedef typename BasicQuadric<T>::vec_type vec_type;
+
+    BasicQuadric<T> Q = quadrics[pair.m_v0] + quadrics[pair.m_v1];
+
+    vec_type vp0(m_mesh->vPosition(pair.m_v0)), vp1(m_mesh->vPosition(pair.m_v1)),
+            vm = (vp0 + vp1) * T(0.5);
 
-                // get normal of imaginary plane intersecting the edge and perpendicular to the face
-                glm::vec3 cpn = glm::normalize(glm::cross(ev, on));
+    vec_type pos;
+    T cost;
 
-                // weight this quadric by a penalty
-                m_quadrics[v] += Quadric(cpn, vpos) * boundaryPenalty;
+    if (m_solver == PseudoInverseSolver) {
+        Q.optimumPseudoInverse(vm, &pos, &cost);
+
+    } else if (!Q.optimum(&pos, &cost)) {
+        cost = std::numeric_limits<T>::max();
+        for (const vec_type& p : {vp0, vp1, vm}) {
+            T c = Q(p);
+            if (c < cost) {
+                cost = c;
+                pos = p;
             }
         }
     }
+
+    pair.m_newPos = glm::vec3(pos);
+    pair.m_cost = float(cost);
 }
 
-void MeshDecimator::computePairCost(std::size_t p)
+MeshDecimator::PairCostBatch::PairCostBatch()
 {
-    VertexPair& pair = m_pairs[p];
-    float oldCost = pair.m_cost;
+    m_quadrics.reserve(PAIR_BATCH_SIZE);
+    m_positions.reserve(PAIR_BATCH_SIZE);
+    m_costs.reserve(PAIR_BATCH_SIZE);
+    m_solved.reserve(PAIR_BATCH_SIZE);
+
+    m_fallbackQuadrics.reserve(PAIR_BATCH_SIZE * 3);
+    m_fallbackPositions.reserve(PAIR_BATCH_SIZE * 3);
+    m_fallbackCosts.reserve(PAIR_BATCH_SIZE * 3);
+}
 
-    Quadric Q = m_quadrics[pair.m_v0] + m_quadrics[pair.m_v1];
+template<typename Pair>
+void MeshDecimator::evaluatePairCosts(std::vector<Pair> &pairs, const std::size_t *indices, std::size_t count, PairCostBatch &batch)
+{
+    // only the given pairs are modified, so this may run concurrently for disjoint sets of pairs
 
-    if (!Q.optimum(&pair.m_newPos, &pair.m_cost)) {
+    // the vectorized code path only supports single precision and the determinant solver
+    if (m_precision == DoublePrecision) {
+        for (std::size_t i = 0; i < count; ++i) {
+            evaluatePairCost(pairs[indices[i]], m_doubleQuadrics);
+        }
+        return;
+    }
 
-        glm::vec3 vp0 = m_mesh->vPosition(pair.m_v0), vp1 = m_mesh->vPosition(pair.m_v1),
-                vm = (vp0 + vp1) * 0.5f;
+    if (m_solver != DeterminantSolver) {
+        for (std::size_t i = 0; i < count; ++i) {
+            evaluatePairCost(pairs[indices[i]], m_quadrics);
+        }
+        return;
+    }
 
-        pair.m_cost = std::numeric_limits<float>::max();
-        for (glm::vec3 pos : {vp0, vp1, vm}) {
-            float cost = Q(pos);
-            if (cost < pair.m_cost) {
-                pair.m_cost = cost;
-                pair.m_newPos = pos;
+    for (std::size_t first = 0; first < count; first += PAIR_BATCH_SIZE) {
+        const std::size_t* block = indices + first;
+        std::size_t n = std::min<std::size_t>(count - first, PAIR_BATCH_SIZE);
+
+        batch.m_quadrics.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            const Pair& pair = pairs[block[i]];
+            batch.m_quadrics.push_back(m_quadrics[pair.m_v0] + m_quadrics[pair.m_v1]);
+        }
+
+        batch.m_positions.resize(n);
+        batch.m_costs.resize(n);
+        batch.m_solved.resize(n);
+        batch.m_quadrics.optimum(batch.m_positions.data(), batch.m_costs.data(), batch.m_solved.data());
+
+        // the optimum of a singular quadric is not unique: try both end points and the midpoint instead
+        batch.m_fallbackQuadrics.clear();
+        batch.m_fallbackPositions.clear();
+
+        for (std::size_t i = 0; i < n; ++i) {
+            Pair& pair = pairs[block[i]];
+
+            if (batch.m_solved[i]) {
+                pair.m_newPos = batch.m_positions[i];
+                pair.m_cost = batch.m_costs[i];
+                continue;
+            }
+
+            Quadric Q = m_quadrics[pair.m_v0] + m_quadrics[pair.m_v1];
+            glm::vec3 vp0 = m_mesh->vPosition(pair.m_v0), vp1 = m_mesh->vPosition(pair.m_v1),
+                    vm = (vp0 + vp1) * 0.5f;
+
+            for (const glm::vec3& pos : {vp0, vp1, vm}) {
+                batch.m_fallbackQuadrics.push_back(Q);
+                batch.m_fallbackPositions.push_back(pos);
+            }
+        }
+
+        if (batch.m_fallbackQuadrics.empty())
+            continue;
+
+        batch.m_fallbackCosts.resize(batch.m_fallbackQuadrics.size());
+        batch.m_fallbackQuadrics.evaluate(batch.m_fallbackPositions.data(), batch.m_fallbackCosts.data());
+
+        for (std::size_t i = 0, j = 0; i < n; ++i) {
+            if (batch.m_solved[i]) continue;
+
+            Pair& pair = pairs[block[i]];
+
+            pair.m_cost = std::numeric_limits<float>::max();
+            for (std::size_t k = j; k < j + 3; ++k) {
+                if (batch.m_fallbackCosts[k] < pair.m_cost) {
+                    pair.m_cost = batch.m_fallbackCosts[k];
+                    pair.m_newPos = batch.m_fallbackPositions[k];
+                }
             }
+
+            j += 3;
         }
     }
+}
 
-    if (!pair.isRemoved()) { // fix priority queue
-        if (pair.m_cost < oldCost)
-            m_pairsByCost.decrease(pair.m_handle);
-        else if (pair.m_cost > oldCost)
-            m_pairsByCost.increase(pair.m_handle);
+void MeshDecimator::computePairCosts(const std::size_t *pairs, std::size_t count)
+{
+    m_oldCosts.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        m_oldCosts[i] = m_pairs[pairs[i]].m_cost;
+    }
+
+    evaluatePairCosts(m_pairs, pairs, count, m_costBatch);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!m_pairs[pairs[i]].isRemoved()) { // fix priority queue
+            queueUpdate(pairs[i], m_oldCosts[i]);
+        }
     }
 }
 
-void MeshDecimator::initPairs()
+template<typename Pair>
+void MeshDecimator::collectPairs(std::vector<Pair>& pairs)
 {
     // reserve memory to avoid reallocations
-    m_pairs.reserve(m_mesh->edgeCount());
+    pairs.clear();
+    pairs.reserve(m_mesh->edgeCount());
 
-    std::unordered_set<mesh_index> skipEdges;
     for (mesh_index e = 0; e < m_mesh->halfedgeCount(); ++e) {
-        if (skipEdges.count(e)) continue;
-
-        mesh_index eo = m_mesh->eOpposite(e);
-        skipEdges.insert(eo);
+        // every edge is visited twice (once per halfedge), only keep the one with the lower index
+        if (!m_mesh->eIsValid(e) || m_mesh->eOpposite(e) < e) continue;
 
         mesh_index v0 = m_mesh->eStartVertex(e), v1 = m_mesh->eEndVertex(e);
+        if (isVertexLocked(v0) || isVertexLocked(v1)) continue;
+
+        pairs.push_back(Pair(v0, v1));
+    }
+
+    // initial costs are independent of each other. the pairs are not queued yet, so there is nothing to update
+    parallel_for(pairs.size(), [this, &pairs] (std::size_t begin, std::size_t end) {
+        std::vector<std::size_t> indices(end - begin);
+        for (std::size_t p = begin; p < end; ++p) {
+            indices[p - begin] = p;
+        }
+
+        PairCostBatch batch;
+        evaluatePairCosts(pairs, indices.data(), indices.size(), batch);
+    });
+}
 
-        VertexPair pair(v0, v1);
+void MeshDecimator::initPairs()
+{
+    collectPairs(m_pairs);
+}
 
-        std::size_t p = m_pairs.size();
-        m_pairs.push_back(pair);
+void MeshDecimator::deferPair(std::size_t p)
+{
+    VertexPair& pair = m_pairs[p];
 
-        computePairCost(p);
+    if (!pair.m_deferred) {
+        pair.m_deferred = true;
+        m_deferredPairs.push_back(p);
     }
 }
 
-void MeshDecimator::cleanupPairs()
+void MeshDecimator::retryDeferredPairs()
 {
-    auto it = std::remove_if(m_pairs.begin(), m_pairs.end(), [] (const VertexPair& pair) {
-        return !pair.isValid();
-    });
+    // pairs which have been invalidated or re-queued in the meantime are dropped from the list. a pair is only
+    // tested again if one of its vertices changed after its last test, the others would be rejected again anyway.
+    // the ones which are still not contractable stay deferred
+    std::size_t kept = 0;
+
+    for (std::size_t p : m_deferredPairs) {
+        VertexPair& pair = m_pairs[p];
+
+        if (pair.isValid() && pair.isRemoved()) {
+            if (m_mesh->vVersion(pair.m_v0) <= pair.m_checkedVersion && m_mesh->vVersion(pair.m_v1) <= pair.m_checkedVersion) {
+                m_deferredPairs[kept++] = p;
+                continue;
+            }
 
-    m_pairs.erase(it, m_pairs.end());
+            if (!isPairContractable(pair)) {
+                m_deferredPairs[kept++] = p;
+                continue;
+            }
+
+            queuePush(p);
+            pair.unremove();
+            ++m_stats.m_requeuedPairs;
+        }
+
+        pair.m_deferred = false;
+    }
+
+    m_deferredPairs.resize(kept);
 }
 
-void MeshDecimator::initHelpers()
+bool MeshDecimator::isEntryCurrent(const lazy_pair_heap::entry &e) const
+{
+    const VertexPair& pair = m_pairs[e.m_index];
+    return (e.m_version == pair.m_version) && !pair.isRemoved();
+}
+
+void MeshDecimator::lazyPush(std::size_t p)
+{
+    VertexPair& pair = m_pairs[p];
+
+    // outdates all entries of this pair which are already in the heap
+    m_lazyHeap.push(p, pair.m_cost, ++pair.m_version);
+
+    if (m_lazyHeap.size() > LAZY_HEAP_COMPACT_RATIO * m_pairs.size()) {
+        m_lazyHeap.compact([this] (const lazy_pair_heap::entry& e) {
+            return !isEntryCurrent(e);
+        });
+    }
+}
+
+bool MeshDecimator::queueEmpty()
+{
+    ScopedTimer t(m_queueProfiling ? &m_stats.m_queueMs : nullptr);
+
+    switch (m_queueType) {
+    case FibonacciHeap:
+        return m_pairsByCost.empty();
+
+    case LazyHeap:
+        // drop outdated entries, so that the top of the heap is a queued pair
+        while (!m_lazyHeap.empty() && !isEntryCurrent(m_lazyHeap.top())) {
+            m_lazyHeap.pop();
+            ++m_stats.m_outdatedEntries;
+        }
+
+        return m_lazyHeap.empty();
+
+    default:
+        return m_pairHeap.empty();
+    }
+}
+
+std::size_t MeshDecimator::queuePop()
+{
+    ScopedTimer t(m_queueProfiling ? &m_stats.m_queueMs : nullptr);
+
+    std::size_t p;
+
+    switch (m_queueType) {
+    case FibonacciHeap:
+        p = m_pairsByCost.top();
+        m_pairsByCost.pop();
+        break;
+
+    case LazyHeap:
+        // queueEmpty() has already discarded the outdated entries
+        p = m_lazyHeap.top().m_index;
+        m_lazyHeap.pop();
+        break;
+
+    default:
+        p = m_pairHeap.top();
+        m_pairHeap.pop();
+        break;
+    }
+
+    return p;
+}
+
+void MeshDecimator::queuePush(std::size_t p)
+{
+    ScopedTimer t(m_queueProfiling ? &m_stats.m_queueMs : nullptr);
+
+    VertexPair& pair = m_pairs[p];
+
+    switch (m_queueType) {
+    case FibonacciHeap:
+        pair.m_handle = m_pairsByCost.push(p);
+        break;
+
+    case LazyHeap:
+        lazyPush(p);
+        break;
+
+    default:
+        m_pairHeap.push(p, pair.m_cost);
+        break;
+    }
+}
+
+void MeshDecimator::queueAppend(std::size_t p)
+{
+    VertexPair& pair = m_pairs[p];
+
+    switch (m_queueType) {
+    case FibonacciHeap:
+        queuePush(p);
+        break;
+
+    case LazyHeap:
+        m_lazyHeap.append(p, pair.m_cost, pair.m_version);
+        break;
+
+    default:
+        m_pairHeap.append(p, pair.m_cost);
+        break;
+    }
+}
+
+void MeshDecimator::queueBuild()
+{
+    if (m_queueType == IndexedHeap)
+        m_pairHeap.heapify();
+    else if (m_queueType == LazyHeap)
+        m_lazyHeap.heapify();
+}
+
+void MeshDecimator::queueUpdate(std::size_t p, float oldCost)
+{
+    ScopedTimer t(m_queueProfiling ? &m_stats.m_queueMs : nullptr);
+
+    VertexPair& pair = m_pairs[p];
+
+    switch (m_queueType) {
+    case FibonacciHeap:
+        // the queue is ordered by descending priority: a lower cost means a higher priority
+        if (pair.m_cost < oldCost)
+            m_pairsByCost.increase(pair.m_handle);
+        else if (pair.m_cost > oldCost)
+            m_pairsByCost.decrease(pair.m_handle);
+        break;
+
+    case LazyHeap:
+        if (pair.m_cost != oldCost)
+            lazyPush(p);
+        break;
+
+    default:
+        m_pairHeap.update(p, pair.m_cost);
+        break;
+    }
+}
+
+void MeshDecimator::queueClear()
 {
     m_pairsByCost.clear();
+    m_pairHeap.clear();
+    m_lazyHeap.clear();
+}
+
+void MeshDecimator::linkPair(std::size_t p, unsigned int s)
+{
+    VertexPair& pair = m_pairs[p];
+    mesh_index v = pair.vertex(s);
+
+    // insert at the front of the list
+    mesh_index next = m_pairsByVertex[v];
+    if (next != inv_pair) {
+        VertexPair& nextPair = m_pairs[next];
+        nextPair.m_prevPair[nextPair.slot(v)] = p;
+    }
 
-    m_pairsByVertex.clear();
-    m_pairsByVertex.reserve(m_pairs.size());
+    pair.m_nextPair[s] = next;
+    pair.m_prevPair[s] = inv_pair;
+    m_pairsByVertex[v] = p;
+}
+
+void MeshDecimator::unlinkPair(std::size_t p, unsigned int s)
+{
+    VertexPair& pair = m_pairs[p];
+    mesh_index v = pair.vertex(s);
+
+    mesh_index prev = pair.m_prevPair[s], next = pair.m_nextPair[s];
+
+    if (prev != inv_pair) {
+        VertexPair& prevPair = m_pairs[prev];
+        prevPair.m_nextPair[prevPair.slot(v)] = next;
+    } else {
+        m_pairsByVertex[v] = next;
+    }
+
+    if (next != inv_pair) {
+        VertexPair& nextPair = m_pairs[next];
+        nextPair.m_prevPair[nextPair.slot(v)] = prev;
+    }
+
+    pair.m_nextPair[s] = pair.m_prevPair[s] = inv_pair;
+}
+
+void MeshDecimator::unlinkPair(std::size_t p)
+{
+    unlinkPair(p, 0);
+    unlinkPair(p, 1);
+}
+
+void MeshDecimator::initHelpers()
+{
+    queueClear();
+    if (m_queueType == IndexedHeap)
+        m_pairHeap.reserve(m_pairs.size());
+    else if (m_queueType == LazyHeap)
+        m_lazyHeap.reserve(LAZY_HEAP_COMPACT_RATIO * m_pairs.size() + 1);
+
+    m_pairsByVertex.assign(m_mesh->vertexCount(), inv_pair);
+    resetMarks();
+
+    m_updatedPairs.reserve(PAIR_BATCH_SIZE);
+    m_oldCosts.reserve(PAIR_BATCH_SIZE);
+    m_deferredPairs.clear();
 
     for (std::size_t p = 0; p < m_pairs.size(); ++p) {
         VertexPair& pair = m_pairs[p];
 
         if (!pair.isValid()) continue;
 
-        m_pairsByVertex.emplace(pair.m_v0, p);
-        m_pairsByVertex.emplace(pair.m_v1, p);
+        linkPair(p, 0);
+        linkPair(p, 1);
 
-        pair.m_handle = m_pairsByCost.push(p);
+        queueAppend(p);
         pair.unremove();
     }
+
+    queueBuild();
+}
+
+void MeshDecimator::resetMarks()
+{
+    m_vertexMarks.assign(m_mesh->vertexCount(), 0);
+    m_markedPairs.assign(m_mesh->vertexCount(), inv_pair);
+    m_markEpoch = 0;
+}
+
+void MeshDecimator::nextMarkEpoch()
+{
+    if (++m_markEpoch == 0) {
+        // the counter wrapped around, old marks could be mistaken for new ones
+        std::fill(m_vertexMarks.begin(), m_vertexMarks.end(), 0);
+        m_markEpoch = 1;
+    }
 }
 
-bool MeshDecimator::isPairContractable(const MeshDecimator::VertexPair &pair) const
+ContractionResult MeshDecimator::checkPairContraction(MeshDecimator::VertexPair &pair) const
 {
-    return m_mesh->isPairContractable(pair.m_v0, pair.m_v1, pair.m_newPos);
+    // the last result can be reused as long as the neighbourhoods of both vertices are unchanged. a new position
+    // is only computed for pairs around a collapse, so it can't have changed either
+    if (pair.m_checkedResult != unchecked_result && m_mesh->validVertexCount() > 4
+            && m_mesh->vVersion(pair.m_v0) <= pair.m_checkedVersion && m_mesh->vVersion(pair.m_v1) <= pair.m_checkedVersion)
+        return ContractionResult(pair.m_checkedResult);
+
+    ContractionResult result = m_mesh->checkPairContraction(pair.m_v0, pair.m_v1, pair.m_newPos);
+
+    pair.m_checkedVersion = m_mesh->version();
+    pair.m_checkedResult = result;
+
+    return result;
+}
+
+bool MeshDecimator::isPairContractable(MeshDecimator::VertexPair &pair) const
+{
+    return checkPairContraction(pair) == Contractable;
+}
+
+bool MeshDecimator::countContraction(ContractionResult result)
+{
+    switch (result) {
+    case Contractable: return true;
+    case RejectedTopology: ++m_stats.m_rejectedTopology; break;
+    case RejectedValency: ++m_stats.m_rejectedValency; break;
+    case RejectedFaceFlip: ++m_stats.m_rejectedFaceFlip; break;
+    }
+
+    return false;
+}
+
+bool MeshDecimator::acceptContraction(MeshDecimator::VertexPair &pair)
+{
+    return countContraction(checkPairContraction(pair));
+}
+
+ContractionResult MeshDecimator::checkCandidateContraction(const MeshDecimator::PairCandidate &pair) const
+{
+    // candidates only live for one step or round, so there is nothing to cache
+    return m_mesh->checkPairContraction(pair.m_v0, pair.m_v1, pair.m_newPos);
+}
+
+bool MeshDecimator::acceptCandidate(const MeshDecimator::PairCandidate &pair)
+{
+    return countContraction(checkCandidateContraction(pair));
+}
+
+void MeshDecimator::evaluateCandidate(MeshDecimator::PairCandidate &pair) const
+{
+    if (m_precision == DoublePrecision)
+        evaluatePairCost(pair, m_doubleQuadrics);
+    else
+        evaluatePairCost(pair, m_quadrics);
+}
+
+void MeshDecimator::contractPair(mesh_index v0, mesh_index v1, const glm::vec3 &newPos)
+{
+    m_currentFaceCount -= m_mesh->collapseEdge(m_mesh->vConnectingEdge(v0, v1), newPos);
+    ++m_stats.m_collapses;
+
+    mergeQuadrics(v0, v1);
+}
+
+void MeshDecimator::initLiveVertices()
+{
+    m_liveVertices.clear();
+    m_liveVertexPos.assign(m_mesh->vertexCount(), inv_index);
+
+    for (mesh_index v = 0; v < m_mesh->vertexCount(); ++v) {
+        if (m_mesh->vIsValid(v)) {
+            m_liveVertexPos[v] = m_liveVertices.size();
+            m_liveVertices.push_back(v);
+        }
+    }
+
+    m_candidates.reserve(m_candidateCount);
+    m_failedSamples = 0;
+}
+
+void MeshDecimator::removeLiveVertex(mesh_index v)
+{
+    // swap with the last vertex
+    mesh_index pos = m_liveVertexPos[v], last = m_liveVertices.back();
+
+    m_liveVertices[pos] = last;
+    m_liveVertexPos[last] = pos;
+
+    m_liveVertices.pop_back();
+    m_liveVertexPos[v] = inv_index;
 }
 
 bool MeshDecimator::iterate()
 {
-    if (m_pairsByCost.empty()) { // no pairs left!
+    switch (m_strategy) {
+    case MultipleChoiceStrategy: return iterateMultipleChoice();
+    case BatchedStrategy: return iterateBatched();
+    case ParallelStrategy: return iterateParallel();
+    default: return iterateGreedy();
+    }
+}
+
+bool MeshDecimator::iterateMultipleChoice()
+{
+    if (m_liveVertices.empty())
+        return false;
+
+    // sample random edges by picking a random vertex and a random edge of its fan (reservoir sampling)
+    m_candidates.clear();
+
+    for (unsigned int i = 0; i < m_candidateCount; ++i) {
+        mesh_index v = m_liveVertices[m_random() % m_liveVertices.size()];
+        mesh_index ce = inv_index;
+        unsigned int n = 0;
+
+        for (mesh_index e : m_mesh->vEdgeFan(v)) {
+            if (m_random() % ++n == 0)
+                ce = e;
+        }
+
+        if (!is_valid(ce) || isVertexLocked(v) || isVertexLocked(m_mesh->eEndVertex(ce)))
+            continue;
+
+        m_candidates.push_back(PairCandidate(v, m_mesh->eEndVertex(ce)));
+        evaluateCandidate(m_candidates.back());
+    }
+
+    std::sort(m_candidates.begin(), m_candidates.end(), [] (const PairCandidate& lhs, const PairCandidate& rhs) {
+        return lhs.m_cost < rhs.m_cost;
+    });
+
+    // collapse the cheapest candidate which passes all tests
+    for (const PairCandidate& pair : m_candidates) {
+        if (!acceptCandidate(pair))
+            continue;
+
+        contractPair(pair.m_v0, pair.m_v1, pair.m_newPos);
+        removeLiveVertex(pair.m_v1);
+        m_failedSamples = 0;
+
+        return m_currentFaceCount > m_targetFaceCount;
+    }
+
+    // give up once the rejected samples would have covered every vertex a few times: the mesh is (almost) locked
+    return ++m_failedSamples * m_candidateCount < 4 * m_liveVertices.size() + 64;
+}
+
+std::size_t MeshDecimator::sortCheapestPairs()
+{
+    // evaluate all remaining edges and sort the cheapest fraction of them into m_batchOrder. the pairs of a round
+    // are plain candidates, the queue bookkeeping of VertexPair is not needed here
+    collectPairs(m_candidates);
+
+    if (m_candidates.empty())
+        return 0;
+
+    std::size_t count = std::max<std::size_t>(1, std::size_t(m_candidates.size() * m_batchFraction));
+    count = std::min(count, m_candidates.size());
+
+    m_batchOrder.resize(m_candidates.size());
+    for (std::size_t p = 0; p < m_candidates.size(); ++p) {
+        m_batchOrder[p] = p;
+    }
+
+    auto byCost = [this] (std::size_t lhs, std::size_t rhs) { return m_candidates[lhs].m_cost < m_candidates[rhs].m_cost; };
+    std::nth_element(m_batchOrder.begin(), m_batchOrder.begin() + (count - 1), m_batchOrder.end(), byCost);
+    std::sort(m_batchOrder.begin(), m_batchOrder.begin() + count, byCost);
+
+    return count;
+}
+
+void MeshDecimator::markNeighbourhood(mesh_index v0, mesh_index v1, unsigned int rings)
+{
+    m_vertexMarks[v0] = m_vertexMarks[v1] = m_markEpoch;
+
+    for (mesh_index v : {v0, v1}) {
+        for (mesh_index e : m_mesh->vEdgeFan(v)) {
+            mesh_index w = m_mesh->eEndVertex(e);
+            m_vertexMarks[w] = m_markEpoch;
+
+            if (rings < 2)
+                continue;
+
+            for (mesh_index we : m_mesh->vEdgeFan(w)) {
+                m_vertexMarks[m_mesh->eEndVertex(we)] = m_markEpoch;
+            }
+        }
+    }
+}
+
+bool MeshDecimator::iterateBatched()
+{
+    // one round: collapse the cheapest edges which do not affect each other
+    std::size_t count = sortCheapestPairs();
+
+    if (count == 0)
+        return false;
+
+    // a vertex is marked once a collapse in this round has touched it. the costs of pairs whose vertices are all
+    // unmarked are still exact, since their quadrics have not changed
+    nextMarkEpoch();
+
+    unsigned int collapses = 0;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (isAborting() || m_currentFaceCount <= roundTargetFaceCount())
+            break;
+
+        const PairCandidate& pair = m_candidates[m_batchOrder[i]];
+        mesh_index v0 = pair.m_v0, v1 = pair.m_v1;
+
+        if (m_vertexMarks[v0] == m_markEpoch || m_vertexMarks[v1] == m_markEpoch)
+            continue;
+
+        if (!acceptCandidate(pair))
+            continue;
+
+        markNeighbourhood(v0, v1, 1);
+
+        contractPair(v0, v1, pair.m_newPos);
+        ++collapses;
+
+        updateProgress();
+    }
+
+    return (collapses > 0) && (m_currentFaceCount > m_targetFaceCount);
+}
+
+bool MeshDecimator::iterateParallel()
+{
+    std::size_t count = sortCheapestPairs();
+
+    if (count == 0)
+        return false;
+
+    // select the edges of this round: the end points of two selected edges are at least three edges apart,
+    // so no face is touched by one collapse and read by the test or collapse of another one
+    nextMarkEpoch();
+    m_selectedPairs.clear();
+
+    unsigned int expectedFaceCount = m_currentFaceCount;
+    unsigned int roundTarget = roundTargetFaceCount();
+
+    for (std::size_t first = 0; first < count && expectedFaceCount > roundTarget; ) {
+        // test the next chunk of candidates which are not blocked yet. nothing is collapsed before all edges of
+        // this round have been selected, so the tests are independent of each other
+        m_checkedPairs.clear();
+        for (; first < count && m_checkedPairs.size() < SELECTION_CHUNK_SIZE; ++first) {
+            const PairCandidate& pair = m_candidates[m_batchOrder[first]];
+            if (m_vertexMarks[pair.m_v0] != m_markEpoch && m_vertexMarks[pair.m_v1] != m_markEpoch)
+                m_checkedPairs.push_back(m_batchOrder[first]);
+        }
+
+        m_batchResults.resize(m_checkedPairs.size());
+
+        parallel_for(m_checkedPairs.size(), [this] (std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                m_batchResults[i] = checkCandidateContraction(m_candidates[m_checkedPairs[i]]);
+            }
+        }, COLLAPSE_GRAIN_SIZE);
+
+        for (std::size_t i = 0; i < m_checkedPairs.size() && expectedFaceCount > roundTarget; ++i) {
+            const PairCandidate& pair = m_candidates[m_checkedPairs[i]];
+            mesh_index v0 = pair.m_v0, v1 = pair.m_v1;
+
+            // blocked by an edge of the same chunk
+            if (m_vertexMarks[v0] == m_markEpoch || m_vertexMarks[v1] == m_markEpoch)
+                continue;
+
+            if (!countContraction(m_batchResults[i]))
+                continue;
+
+            markNeighbourhood(v0, v1, 2);
+            m_selectedPairs.push_back(m_checkedPairs[i]);
+
+            // interior edges remove two faces, boundary edges one
+            mesh_index e = m_mesh->vConnectingEdge(v0, v1);
+            unsigned int faces = (m_mesh->eIsBoundary(e) ? 0 : 1) + (m_mesh->eIsBoundary(m_mesh->eOpposite(e)) ? 0 : 1);
+            expectedFaceCount -= std::min(faces, expectedFaceCount);
+        }
+    }
+
+    if (m_selectedPairs.empty())
+        return false;
+
+    // collapse the selected edges concurrently
+    std::atomic<unsigned int> removedFaces(0);
+
+    parallel_for(m_selectedPairs.size(), [this, &removedFaces] (std::size_t begin, std::size_t end) {
+        unsigned int removed = 0;
+
+        for (std::size_t i = begin; i < end; ++i) {
+            const PairCandidate& pair = m_candidates[m_selectedPairs[i]];
+
+            removed += m_mesh->collapseEdge(m_mesh->vConnectingEdge(pair.m_v0, pair.m_v1), pair.m_newPos);
+            mergeQuadrics(pair.m_v0, pair.m_v1);
+        }
+
+        removedFaces.fetch_add(removed, std::memory_order_relaxed);
+    }, COLLAPSE_GRAIN_SIZE);
+
+    m_currentFaceCount -= removedFaces.load();
+    m_stats.m_collapses += m_selectedPairs.size();
+
+    return m_currentFaceCount > m_targetFaceCount;
+}
+
+bool MeshDecimator::iterateGreedy()
+{
+    if (queueEmpty()) { // no pairs left!
         if (m_currentFaceCount == m_lastAttemptFaceCount) {
             // no progress was made since last attempt: abort!
             return false;
@@ -147,19 +910,27 @@ bool MeshDecimator::iterate()
 
         m_lastAttemptFaceCount = m_currentFaceCount;
 
-        // otherwise: clean up data and try again!
-        cleanupPairs();
-        initHelpers();
+        // otherwise: give the deferred pairs another chance. the other pairs are still valid
+        retryDeferredPairs();
+        ++m_stats.m_retryRounds;
+
+        if (queueEmpty())
+            return false;
     }
 
     // get pair with lowest cost (top of the priority queue)
-    std::size_t p = m_pairsByCost.top();
-    m_pairsByCost.pop();
+    std::size_t p = queuePop();
 
     VertexPair& curPair = m_pairs[p];
     curPair.remove();
 
-    if (!(curPair.isValid() && isPairContractable(curPair))) {
+    if (!curPair.isValid()) {
+        ++m_stats.m_stalePairs;
+        return true;
+    }
+
+    if (!acceptContraction(curPair)) {
+        deferPair(p);
         return true;
     }
 
@@ -168,60 +939,86 @@ bool MeshDecimator::iterate()
 
     // perform edge collapse
     m_currentFaceCount -= m_mesh->collapseEdge(collEdge, curPair.m_newPos);
+    ++m_stats.m_collapses;
 
-    // update pairs
-    auto v1Range = m_pairsByVertex.equal_range(v1);
-    for (auto it = v1Range.first; it != v1Range.second; ++it) {
-        std::size_t p1 = it->second;
-        if (p1 == p) continue;
-
+    // update pairs: move all pairs of v1 over to v0
+    for (mesh_index p1 = m_pairsByVertex[v1]; p1 != inv_pair; ) {
         VertexPair& pair = m_pairs[p1];
-        if (!pair.isValid()) continue;
+        unsigned int s = pair.slot(v1);
+        mesh_index next = pair.m_nextPair[s];
 
-        m_pairsByVertex.emplace(v0, p1);
+        if (p1 != p) {
+            if (s == 0)
+                pair.m_v0 = v0;
+            else
+                pair.m_v1 = v0;
 
-        if (pair.m_v0 == v1)
-            pair.m_v0 = v0;
-        else
-            pair.m_v1 = v0;
+            linkPair(p1, s);
+        }
+
+        p1 = next;
     }
 
-    m_pairsByVertex.erase(v1Range.first, v1Range.second);
+    m_pairsByVertex[v1] = inv_pair;
 
+    unlinkPair(p, curPair.slot(v0));
     curPair.invalidate();
 
     // update quadrics
-    m_quadrics[v0] += m_quadrics[v1];
+    mergeQuadrics(v0, v1);
 
-    std::unordered_set<mesh_index> duplicateHelper;
+    // marks all vertices already connected to v0 by a pair
+    nextMarkEpoch();
 
-    // update cost of affected pairs
-    auto v0Range = m_pairsByVertex.equal_range(v0);
-    for (auto it = v0Range.first; it != v0Range.second; ++it) {
-        std::size_t pi = it->second;
+    // remove duplicate pairs (v0 and v1 might have had common neighbours)
+    for (mesh_index pi = m_pairsByVertex[v0]; pi != inv_pair; ) {
         VertexPair& pair = m_pairs[pi];
-        mesh_index ov = (pair.m_v0 == v0) ? pair.m_v1 : pair.m_v0;
-
-        if (!pair.isValid())
-            continue;
-
-        if (duplicateHelper.count(ov)) {
-            pair.invalidate();
+        mesh_index next = pair.m_nextPair[pair.slot(v0)];
+        mesh_index ov = pair.otherVertex(v0);
+
+        if (m_vertexMarks[ov] == m_markEpoch) {
+            // v0 and ov are already connected by another pair. keep the one which is still queued
+            mesh_index pd = m_markedPairs[ov];
+            if (m_pairs[pd].isRemoved() && !pair.isRemoved()) {
+                unlinkPair(pd);
+                m_pairs[pd].invalidate();
+                m_markedPairs[ov] = pi;
+            } else {
+                unlinkPair(pi);
+                pair.invalidate();
+            }
         } else {
-            duplicateHelper.insert(ov);
-            computePairCost(pi);
+            m_vertexMarks[ov] = m_markEpoch;
+            m_markedPairs[ov] = pi;
         }
 
-        auto ovRange = m_pairsByVertex.equal_range(ov);
-        for (auto it = ovRange.first; it != ovRange.second; ++it) {
-            std::size_t vp = it->second;
+        pi = next;
+    }
+
+    // update cost of affected pairs
+    m_updatedPairs.clear();
+    for (mesh_index pi = m_pairsByVertex[v0]; pi != inv_pair; pi = m_pairs[pi].m_nextPair[m_pairs[pi].slot(v0)]) {
+        m_updatedPairs.push_back(pi);
+    }
+
+    computePairCosts(m_updatedPairs.data(), m_updatedPairs.size());
+
+    for (std::size_t pi : m_updatedPairs) {
+        mesh_index ov = m_pairs[pi].otherVertex(v0);
+
+        for (mesh_index vp = m_pairsByVertex[ov]; vp != inv_pair; ) {
             VertexPair& vpair = m_pairs[vp];
-            if (vpair.isValid() && vpair.isRemoved()) {
+            mesh_index vnext = vpair.m_nextPair[vpair.slot(ov)];
+
+            if (vpair.isRemoved()) {
                 if (isPairContractable(vpair)) {
-                    vpair.m_handle = m_pairsByCost.push(vp); // a recently removed pair has become valid again! re-add it to the heap
+                    queuePush(vp); // a recently removed pair has become valid again! re-add it to the heap
                     vpair.unremove();
+                    ++m_stats.m_requeuedPairs;
                 }
             }
+
+            vp = vnext;
         }
     }
 
@@ -231,15 +1028,51 @@ bool MeshDecimator::iterate()
     return true;
 }
 
-void MeshDecimator::updateProgress()
+void MeshDecimator::updateProgress(bool force)
+{
+    float p = progress();
+
+    if (!force) {
+        if (p - m_lastProgress < m_progressStep)
+            return;
+
+        if (m_progressInterval > 0 && m_progressTimer.elapsed() < m_progressInterval)
+            return;
+    }
+
+    m_lastProgress = p;
+    m_progressTimer.restart();
+
+    emit progressChanged(p);
+}
+
+MeshDecimator::~MeshDecimator() { }
+
+void MeshDecimator::setLodFaceCounts(std::vector<unsigned int> faceCounts)
+{
+    std::sort(faceCounts.begin(), faceCounts.end(), std::greater<unsigned int>());
+    m_lodFaceCounts = std::move(faceCounts);
+}
+
+unsigned int MeshDecimator::roundTargetFaceCount() const
 {
-    emit progressChanged(progress());
+    // rounds of the batched strategies stop at the next level of detail, so that it is not skipped over
+    std::size_t next = m_lodMeshes.size();
+
+    if (next < m_lodFaceCounts.size() && m_lodFaceCounts[next] > m_targetFaceCount)
+        return m_lodFaceCounts[next];
+
+    return m_targetFaceCount;
 }
 
-MeshDecimator::~MeshDecimator()
+void MeshDecimator::takeLodSnapshots(bool final)
 {
-    m_mesh->cleanupData();
-    m_mesh->recomputeNormals();
+    while (m_lodMeshes.size() < m_lodFaceCounts.size()) {
+        if (!final && m_currentFaceCount > m_lodFaceCounts[m_lodMeshes.size()])
+            break;
+
+        m_lodMeshes.push_back(m_mesh->compactCopy());
+    }
 }
 
 float MeshDecimator::progress() const
@@ -254,16 +1087,12 @@ float MeshDecimator::progress() const
 
 bool MeshDecimator::isAborting() const
 {
-    QMutexLocker ml(&m_mutex);
-
-    return m_abort;
+    return m_abort.load(std::memory_order_relaxed);
 }
 
 void MeshDecimator::abort()
 {
-    QMutexLocker ml(&m_mutex);
-
-    m_abort = true;
+    m_abort.store(true, std::memory_order_relaxed);
 }
 
 void MeshDecimator::start()
@@ -277,21 +1106,79 @@ void MeshDecimator::start()
             }
 
             m_lastAttemptFaceCount = m_oldFaceCount = m_currentFaceCount = m_mesh->faceCount();
+            m_stats = DecimationStats();
+            m_stats.m_queueTimed = m_queueProfiling;
+            m_stats.m_facesBefore = m_oldFaceCount;
+            m_stats.m_targetFaces = m_targetFaceCount;
+            m_lodMeshes.clear();
+
+            QElapsedTimer timer;
+            timer.start();
 
             computeQuadrics();
-            initPairs();
-            initHelpers();
+            m_stats.m_computeQuadricsMs = elapsedMs(timer);
+
+            if (m_strategy == GreedyStrategy) {
+                initPairs();
+                m_stats.m_initPairsMs = elapsedMs(timer);
+
+                initHelpers();
+                m_stats.m_initQueueMs = elapsedMs(timer);
+            } else {
+                // the pairs are (re-)evaluated by iterate()
+                if (m_strategy == MultipleChoiceStrategy)
+                    initLiveVertices();
+                else
+                    resetMarks();
+
+                m_stats.m_initPairsMs = elapsedMs(timer);
+            }
+
+            m_lastProgress = 0.0f;
+            m_progressTimer.start();
+
+            takeLodSnapshots(false);
+
+            unsigned long long allocationsBefore = m_allocationCounter ? m_allocationCounter() : 0;
 
             while (true) {
                 if (isAborting() || !iterate())
                     break;
 
+                takeLodSnapshots(false);
                 updateProgress();
             }
+
+            if (m_allocationCounter) {
+                m_stats.m_iterateAllocations = m_allocationCounter() - allocationsBefore;
+                m_stats.m_allocationsCounted = true;
+            }
+
+            m_stats.m_iterateMs = elapsedMs(timer);
         } catch (std::runtime_error& e) {
             emit error(QString(e.what()));
         }
+
+        // remove collapsed primitives, so that the mesh can be rendered and exported
+        QElapsedTimer timer;
+        timer.start();
+
+        m_mesh->cleanupData();
+        m_stats.m_cleanupMs = elapsedMs(timer);
+
+        m_mesh->recomputeNormals();
+        m_stats.m_normalsMs = elapsedMs(timer);
+
+        // levels which have not been reached
+        takeLodSnapshots(true);
+
+        m_stats.m_facesAfter = m_mesh->faceCount();
+        m_stats.m_peakMemoryBytes = peakMemoryUsage();
     }
 
+    updateProgress(true);
+
+    emit statsAvailable(m_stats);
+
     emit finished();
 }
@@ -0,0 +1,530 @@
+#include "mesh.hpp"
+#include "mesh_decimator.hpp"
+#include "quadric_batch.hpp"
+#include "scenefile.hpp"
+#include "util.hpp"
+
+#include <assimp/mesh.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QTextStream>
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace
+{
+
+// number of calls to the global operator new since program start
+std::atomic<unsigned long long> g_allocationCount(0);
+
+// bytes currently allocated by operator new, and the largest value since the last resetHeapPeak(). signed, since
+// blocks allocated by another module (e.g. an assimp DLL) may be released here
+std::atomic<long long> g_heapBytes(0);
+std::atomic<long long> g_heapPeak(0);
+
+/*!
+ * \brief returns the usable size of a block returned by malloc, or 0 if unknown
+ */
+std::size_t allocationSize(void* ptr)
+{
+#if defined(_WIN32)
+    return _msize(ptr);
+#elif defined(__APPLE__)
+    return malloc_size(ptr);
+#elif defined(__GLIBC__)
+    return malloc_usable_size(ptr);
+#else
+    Q_UNUSED(ptr);
+    return 0;
+#endif
+}
+
+/*!
+ * \brief starts a new heap high-water mark at the current heap size and returns it
+ */
+long long resetHeapPeak()
+{
+    long long current = g_heapBytes.load();
+    g_heapPeak.store(current);
+    return current;
+}
+
+}
+
+// count every heap allocation of the process and track the heap size, so regressions in the decimation loop show
+// up in the results. the array and sized forms of new and delete forward to these by default
+void* operator new(std::size_t size)
+{
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        long long blockSize = allocationSize(ptr);
+        long long current = g_heapBytes.fetch_add(blockSize, std::memory_order_relaxed) + blockSize;
+        long long peak = g_heapPeak.load(std::memory_order_relaxed);
+        while (current > peak && !g_heapPeak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) { }
+
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr)
+        g_heapBytes.fetch_sub(static_cast<long long>(allocationSize(ptr)), std::memory_order_relaxed);
+
+    std::free(ptr);
+}
+
+namespace
+{
+
+aiMesh* makeImportMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+{
+    aiMesh* mesh = new aiMesh();
+
+    unsigned int vc = positions.size();
+    mesh->mNumVertices = vc;
+    mesh->mVertices = new aiVector3D[vc];
+    mesh->mNormals = new aiVector3D[vc];
+
+    for (unsigned int v = 0; v < vc; ++v) {
+        const glm::vec3& p = positions[v];
+        glm::vec3 n = glm::normalize(p);
+        mesh->mVertices[v] = aiVector3D(p.x, p.y, p.z);
+        mesh->mNormals[v] = aiVector3D(n.x, n.y, n.z);
+    }
+
+    unsigned int fc = indices.size() / 3;
+    mesh->mNumFaces = fc;
+    mesh->mFaces = new aiFace[fc];
+
+    for (unsigned int f = 0; f < fc; ++f) {
+        aiFace& face = mesh->mFaces[f];
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned int[3];
+        face.mIndices[0] = indices[f*3 + 0];
+        face.mIndices[1] = indices[f*3 + 1];
+        face.mIndices[2] = indices[f*3 + 2];
+    }
+
+    return mesh;
+}
+
+/*!
+ * \brief creates a subdivided icosahedron with roughly the given number of faces
+ */
+aiMesh* makeSphere(unsigned int faceCount)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+
+    std::vector<glm::vec3> positions = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+
+    std::vector<unsigned int> indices = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+    };
+
+    for (glm::vec3& p : positions)
+        p = glm::normalize(p);
+
+    while (indices.size() / 3 * 4 <= faceCount) {
+        std::unordered_map<std::uint64_t, unsigned int> midpoints;
+        std::vector<unsigned int> newIndices;
+        newIndices.reserve(indices.size() * 4);
+
+        auto midpoint = [&] (unsigned int a, unsigned int b) {
+            std::uint64_t key = (std::uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+            auto r = midpoints.emplace(key, positions.size());
+            if (r.second)
+                positions.push_back(glm::normalize(positions[a] + positions[b]));
+            return r.first->second;
+        };
+
+        for (std::size_t i = 0; i < indices.size(); i += 3) {
+            unsigned int a = indices[i], b = indices[i+1], c = indices[i+2];
+            unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            newIndices.insert(newIndices.end(), { a, ab, ca,   b, bc, ab,   c, ca, bc,   ab, bc, ca });
+        }
+
+        indices.swap(newIndices);
+    }
+
+    return makeImportMesh(positions, indices);
+}
+
+/*!
+ * \brief creates a noisy height field (with a boundary) with roughly the given number of faces
+ */
+aiMesh* makeGrid(unsigned int faceCount)
+{
+    unsigned int n = std::max(1u, static_cast<unsigned int>(std::sqrt(faceCount * 0.5)));
+
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> noise(-0.2f, 0.2f);
+
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    for (unsigned int y = 0; y <= n; ++y)
+        for (unsigned int x = 0; x <= n; ++x)
+            positions.push_back(glm::vec3(x, y, noise(rng)));
+
+    for (unsigned int y = 0; y < n; ++y) {
+        for (unsigned int x = 0; x < n; ++x) {
+            unsigned int a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            indices.insert(indices.end(), { a, b, d,   a, d, c });
+        }
+    }
+
+    return makeImportMesh(positions, indices);
+}
+
+/*!
+ * \brief creates clusters of open triangle fans with roughly the given number of faces. the fans of every cluster
+ * share their center vertex, which makes it non-manifold
+ */
+aiMesh* makeFans(unsigned int faceCount)
+{
+    const unsigned int fansPerCluster = 3, trianglesPerFan = 8;
+    const float pi = 3.14159265f;
+
+    unsigned int clusterCount = std::max(1u, faceCount / (fansPerCluster * trianglesPerFan));
+    unsigned int n = static_cast<unsigned int>(std::ceil(std::sqrt(float(clusterCount))));
+
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    for (unsigned int c = 0; c < clusterCount; ++c) {
+        glm::vec3 center(float(c % n) * 3.0f, float(c / n) * 3.0f, 0.0f);
+
+        unsigned int ci = positions.size();
+        positions.push_back(center);
+
+        for (unsigned int f = 0; f < fansPerCluster; ++f) {
+            // every fan lies in a different plane through the center and covers half a disc
+            float tilt = pi * float(f) / float(fansPerCluster);
+            glm::vec3 u(std::cos(tilt), std::sin(tilt), 0.0f), v(0.0f, 0.0f, 1.0f);
+
+            unsigned int ri = positions.size();
+            for (unsigned int r = 0; r <= trianglesPerFan; ++r) {
+                float a = pi * float(r) / float(trianglesPerFan);
+                positions.push_back(center + u * std::cos(a) + v * std::sin(a) * (f % 2 ? 1.0f : -1.0f));
+            }
+
+            for (unsigned int t = 0; t < trianglesPerFan; ++t) {
+                indices.insert(indices.end(), { ci, ri + t, ri + t + 1 });
+            }
+        }
+    }
+
+    return makeImportMesh(positions, indices);
+}
+
+const char* queueName(MeshDecimator::QueueType type)
+{
+    switch (type) {
+    case MeshDecimator::FibonacciHeap: return "fibonacci";
+    case MeshDecimator::IndexedHeap: return "indexed";
+    case MeshDecimator::LazyHeap: return "lazy";
+    }
+    return "";
+}
+
+const char* strategyName(MeshDecimator::Strategy strategy)
+{
+    switch (strategy) {
+    case MeshDecimator::GreedyStrategy: return "greedy";
+    case MeshDecimator::MultipleChoiceStrategy: return "multiple-choice";
+    case MeshDecimator::BatchedStrategy: return "batched";
+    case MeshDecimator::ParallelStrategy: return "parallel";
+    }
+    return "";
+}
+
+struct Options
+{
+    double m_ratio;
+    int m_runs;
+    std::vector<MeshDecimator::QueueType> m_queues;
+    std::vector<MeshDecimator::Strategy> m_strategies;
+    MeshDecimator::Precision m_precision;
+    MeshDecimator::Solver m_solver;
+    bool m_queueProfiling;
+};
+
+/*!
+ * \brief measurements of a single run
+ */
+struct RunResult
+{
+    double m_processMs;
+    double m_exportMs;
+    DecimationStats m_stats;
+    unsigned long long m_allocations;
+    long long m_peakHeapBytes; // heap high-water mark of the run above the heap size before it
+    unsigned int m_facesAfter;
+};
+
+/*!
+ * \brief builds, decimates and exports a mesh several times and prints the fastest run as one JSON object
+ */
+void runBenchmark(const QString& meshName, const QString& source, const aiMesh* importMesh, MeshDecimator::Strategy strategy,
+                  MeshDecimator::QueueType queue, const Options& options)
+{
+    RunResult best;
+
+    for (int r = 0; r < options.m_runs; ++r) {
+        RunResult result;
+
+        long long heapBefore = resetHeapPeak();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        Mesh mesh(importMesh);
+
+        result.m_processMs = elapsedMs(timer);
+
+        unsigned int target = static_cast<unsigned int>(mesh.importedFaceCount() * options.m_ratio);
+
+        MeshDecimator decimator(&mesh, target, queue);
+        decimator.setStrategy(strategy);
+        decimator.setPrecision(options.m_precision);
+        decimator.setSolver(options.m_solver);
+        decimator.setQueueProfiling(options.m_queueProfiling);
+        decimator.setAllocationCounter([] { return g_allocationCount.load(); });
+
+        unsigned long long allocationsBefore = g_allocationCount.load();
+        decimator.start();
+        result.m_allocations = g_allocationCount.load() - allocationsBefore;
+
+        result.m_stats = decimator.stats();
+        result.m_facesAfter = mesh.faceCount();
+
+        timer.restart();
+
+        std::unique_ptr<aiMesh> exportMesh(mesh.makeExportMesh());
+
+        result.m_exportMs = elapsedMs(timer);
+        result.m_peakHeapBytes = g_heapPeak.load() - heapBefore;
+
+        if (r == 0 || result.m_stats.totalMs() < best.m_stats.totalMs())
+            best = result;
+    }
+
+    unsigned int facesBefore = importMesh->mNumFaces;
+    const DecimationStats& stats = best.m_stats;
+
+    QJsonObject result;
+    result["mesh"] = meshName;
+    result["source"] = source;
+    result["strategy"] = QString(strategyName(strategy));
+    if (strategy == MeshDecimator::GreedyStrategy)
+        result["queue"] = QString(queueName(queue));
+    result["simd"] = QString(quadric_batch::simdLevelName(quadric_batch::simdLevel()));
+    result["precision"] = QString(options.m_precision == MeshDecimator::DoublePrecision ? "double" : "single");
+    result["solver"] = QString(options.m_solver == MeshDecimator::PseudoInverseSolver ? "pseudo-inverse" : "determinant");
+
+    // phase timings and counters of the decimator
+    QJsonObject statsJson = stats.toJson();
+    statsJson.remove("peak_memory_bytes");
+    for (auto it = statsJson.begin(); it != statsJson.end(); ++it) {
+        result[it.key()] = it.value();
+    }
+
+    // the resident set size of the process can't be reset between runs, so the peak memory of a run is measured as
+    // the high-water mark of the heap above its size before the run (mesh, decimator and exported mesh)
+    result["peak_heap_bytes"] = double(best.m_peakHeapBytes);
+
+    result["process_imported_mesh_ms"] = best.m_processMs;
+    result["make_export_mesh_ms"] = best.m_exportMs;
+    result["decimate_ms"] = stats.totalMs();
+
+    unsigned int removedFaces = facesBefore - best.m_facesAfter;
+    result["import_faces_per_second"] = facesBefore / (best.m_processMs * 1e-3);
+    result["faces_per_second"] = removedFaces / (stats.totalMs() * 1e-3);
+
+    // all allocations of start() (including setup and cleanup), and only those of the collapse loop per collapse
+    // (iterate_allocations), which should stay at zero
+    result["allocations"] = double(best.m_allocations);
+    result["allocations_per_collapse"] = double(stats.m_iterateAllocations) / std::max(1ull, stats.m_collapses);
+
+    QTextStream out(stdout);
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << endl;
+}
+
+/*!
+ * \brief benchmarks every selected strategy (and every selected queue type of the greedy strategy)
+ */
+void runBenchmarks(const QString& meshName, const QString& source, const aiMesh* importMesh, const Options& options)
+{
+    for (MeshDecimator::Strategy strategy : options.m_strategies) {
+        if (strategy == MeshDecimator::GreedyStrategy) {
+            for (MeshDecimator::QueueType queueType : options.m_queues) {
+                runBenchmark(meshName, source, importMesh, strategy, queueType, options);
+            }
+        } else {
+            runBenchmark(meshName, source, importMesh, strategy, MeshDecimator::IndexedHeap, options);
+        }
+    }
+}
+
+void printError(const QString& msg)
+{
+    QTextStream err(stderr);
+    err << "meshbench: " << msg << endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("meshbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Decimation benchmark on synthetic meshes and mesh files. Prints one JSON object per run to stdout.");
+    parser.addHelpOption();
+
+    QCommandLineOption sizesOption(QStringList() << "n" << "sizes", "Comma separated approximate face counts of the generated meshes.", "counts", "10000,100000,1000000,10000000");
+    QCommandLineOption meshesOption(QStringList() << "m" << "meshes", "Comma separated list of generated meshes: sphere, grid, fans (default: all).", "names", "sphere,grid,fans");
+    QCommandLineOption ratioOption(QStringList() << "r" << "ratio", "Target face count relative to the input.", "ratio", "0.1");
+    QCommandLineOption runsOption("runs", "Number of runs per configuration (the fastest one is reported).", "count", "3");
+    QCommandLineOption strategyOption("strategy", "Collapse order: greedy, multiple-choice, batched, parallel or all (default: greedy).", "name", "greedy");
+    QCommandLineOption queueOption("queue", "Priority queue: indexed, fibonacci, lazy or all (default: indexed).", "name", "indexed");
+    QCommandLineOption precisionOption("precision", "Floating point precision of the error quadrics: single or double (default: single).", "type", "single");
+    QCommandLineOption solverOption("solver", "Vertex placement: determinant or pseudo-inverse (default: determinant).", "name", "determinant");
+    QCommandLineOption queueProfilingOption("profile-queue", "Measure the time spent in priority queue operations (adds timer overhead).");
+    QCommandLineOption simdOption("simd", "Instruction set used for quadric math: scalar, sse or avx (default: best supported).", "level");
+
+    parser.addOption(sizesOption);
+    parser.addOption(meshesOption);
+    parser.addOption(ratioOption);
+    parser.addOption(runsOption);
+    parser.addOption(strategyOption);
+    parser.addOption(queueOption);
+    parser.addOption(precisionOption);
+    parser.addOption(solverOption);
+    parser.addOption(queueProfilingOption);
+    parser.addOption(simdOption);
+    parser.addPositionalArgument("files", "Mesh files to benchmark in addition to the generated meshes.", "[files...]");
+
+    parser.process(app);
+
+    Options options;
+    options.m_ratio = parser.value(ratioOption).toDouble();
+    options.m_runs = std::max(1, parser.value(runsOption).toInt());
+    options.m_precision = parser.value(precisionOption) == "double" ? MeshDecimator::DoublePrecision : MeshDecimator::SinglePrecision;
+    options.m_queueProfiling = parser.isSet(queueProfilingOption);
+    options.m_solver = parser.value(solverOption) == "pseudo-inverse" ? MeshDecimator::PseudoInverseSolver : MeshDecimator::DeterminantSolver;
+
+    QString queue = parser.value(queueOption);
+    if (queue == "indexed" || queue == "all")
+        options.m_queues.push_back(MeshDecimator::IndexedHeap);
+    if (queue == "fibonacci" || queue == "all")
+        options.m_queues.push_back(MeshDecimator::FibonacciHeap);
+    if (queue == "lazy" || queue == "all")
+        options.m_queues.push_back(MeshDecimator::LazyHeap);
+
+    if (options.m_queues.empty()) {
+        printError(QString("unknown queue \"%1\"").arg(queue));
+        return 2;
+    }
+
+    QString strategy = parser.value(strategyOption);
+    if (strategy == "greedy" || strategy == "all")
+        options.m_strategies.push_back(MeshDecimator::GreedyStrategy);
+    if (strategy == "multiple-choice" || strategy == "all")
+        options.m_strategies.push_back(MeshDecimator::MultipleChoiceStrategy);
+    if (strategy == "batched" || strategy == "all")
+        options.m_strategies.push_back(MeshDecimator::BatchedStrategy);
+    if (strategy == "parallel" || strategy == "all")
+        options.m_strategies.push_back(MeshDecimator::ParallelStrategy);
+
+    if (options.m_strategies.empty()) {
+        printError(QString("unknown strategy \"%1\"").arg(strategy));
+        return 2;
+    }
+
+    if (parser.isSet(simdOption)) {
+        QString simd = parser.value(simdOption);
+        for (SimdLevel level : { SimdScalar, SimdSSE, SimdAVX }) {
+            if (simd == quadric_batch::simdLevelName(level))
+                quadric_batch::setSimdLevel(level);
+        }
+    }
+
+    std::vector<unsigned int> sizes;
+    for (const QString& size : parser.value(sizesOption).split(',', QString::SkipEmptyParts)) {
+        sizes.push_back(size.toUInt());
+    }
+    std::sort(sizes.begin(), sizes.end());
+
+    QStringList meshNames = parser.value(meshesOption).split(',', QString::SkipEmptyParts);
+
+    for (unsigned int size : sizes) {
+        for (const QString& name : meshNames) {
+            std::unique_ptr<aiMesh> mesh;
+
+            if (name == "sphere")
+                mesh.reset(makeSphere(size));
+            else if (name == "grid")
+                mesh.reset(makeGrid(size));
+            else if (name == "fans")
+                mesh.reset(makeFans(size));
+            else {
+                printError(QString("unknown mesh \"%1\"").arg(name));
+                return 2;
+            }
+
+            runBenchmarks(name, "generated", mesh.get(), options);
+        }
+    }
+
+    for (const QString& file : parser.positionalArguments()) {
+        SceneFile scene(file);
+
+        if (scene.hasError()) {
+            printError(QString("could not import \"%1\": %2").arg(file, scene.errorString()));
+            continue;
+        }
+
+        for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+            const Mesh* mesh = scene.getMesh(i);
+
+            runBenchmarks(mesh->name(), file, mesh->importedMesh(), options);
+        }
+    }
+
+    return 0;
+}
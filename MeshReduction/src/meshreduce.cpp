@@ -0,0 +1,495 @@
+#include "scenefile.hpp"
+#include "mesh.hpp"
+#include "scene_decimator.hpp"
+#include "streaming_decimator.hpp"
+#include "vertex_clusterer.hpp"
+#include "util.hpp"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QMutex>
+
+#include <assimp/scene.h>
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace
+{
+
+struct Options
+{
+    QString m_formatId;
+    QString m_extension;
+    QString m_outputDir;
+    QString m_suffix;
+
+    unsigned int m_targetFaceCount;
+    double m_ratio;
+    bool m_useRatio;
+
+    int m_jobs;
+    MeshDecimator::Strategy m_strategy;
+    MeshDecimator::Precision m_precision;
+    MeshDecimator::Solver m_solver;
+
+    unsigned int m_clusterResolution; // use VertexClusterer instead of edge collapses if > 0
+
+    bool m_stream;
+    std::size_t m_memoryBudget; // bytes per cluster (if m_stream is set)
+
+    std::vector<double> m_lodRatios; // in descending order. empty if only one level is exported
+};
+
+void printLine(const QJsonObject& obj)
+{
+    QTextStream out(stdout);
+    out << QJsonDocument(obj).toJson(QJsonDocument::Compact) << endl;
+}
+
+void printError(const QString& msg)
+{
+    QTextStream err(stderr);
+    err << "meshreduce: " << msg << endl;
+}
+
+QString outputFileName(const QString& inputFileName, const Options& options, const QString& levelSuffix = QString())
+{
+    QFileInfo fi(inputFileName);
+    QString dir = options.m_outputDir.isEmpty() ? fi.path() : options.m_outputDir;
+    QString name = fi.completeBaseName() + options.m_suffix + levelSuffix + "." + options.m_extension;
+    return QDir::cleanPath(dir + QDir::separator() + name);
+}
+
+/*!
+ * \brief decimates the meshes of a scene one after the other with StreamingDecimator and exports the result
+ */
+void streamScene(const SceneFile& scene, double ratio, const QString& outFileName, const Options& options, QJsonObject& result)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const aiScene* importedScene = scene.importedScene();
+
+    QString decimateError;
+    DecimationStats stats;
+    std::vector<aiMesh*> exportedMeshes;
+
+    QJsonArray meshes;
+    unsigned int totalFaces = 0, resultFaces = 0;
+
+    for (unsigned int i = 0; i < importedScene->mNumMeshes; ++i) {
+        const aiMesh* importedMesh = importedScene->mMeshes[i];
+        unsigned int faces = importedMesh->mNumFaces;
+        unsigned int target = static_cast<unsigned int>(std::lround(faces * ratio));
+
+        StreamingDecimator decimator(importedMesh, target, options.m_memoryBudget);
+        decimator.setStrategy(options.m_strategy);
+        decimator.setPrecision(options.m_precision);
+        decimator.setSolver(options.m_solver);
+        QObject::connect(&decimator, &StreamingDecimator::error, [&decimateError] (QString msg) {
+            decimateError = msg;
+        });
+
+        decimator.start();
+
+        exportedMeshes.push_back(decimator.makeExportMesh());
+        stats += decimator.stats();
+
+        QJsonObject meshResult;
+        meshResult["name"] = QString(importedMesh->mName.C_Str());
+        meshResult["faces_before"] = double(faces);
+        meshResult["faces_after"] = double(decimator.faceCount());
+        meshResult["clusters"] = double(decimator.clusterCount());
+        meshResult["stats"] = decimator.stats().toJson();
+        meshes.append(meshResult);
+
+        totalFaces += faces;
+        resultFaces += decimator.faceCount();
+    }
+
+    result["decimate_ms"] = elapsedMs(timer);
+    result["stats"] = stats.toJson();
+
+    timer.restart();
+
+    QString exportError = scene.exportMeshes(outFileName, options.m_formatId, exportedMeshes);
+
+    result["export_ms"] = elapsedMs(timer);
+    result["faces_before"] = double(totalFaces);
+    result["faces_after"] = double(resultFaces);
+    result["meshes"] = meshes;
+
+    if (!decimateError.isEmpty())
+        result["error"] = decimateError;
+    else if (!exportError.isEmpty())
+        result["error"] = exportError;
+}
+
+/*!
+ * \brief imports, decimates and exports a single file. prints one JSON object describing the run to stdout
+ * \return true on success
+ */
+bool processFile(const QString& inputFileName, const Options& options)
+{
+    QJsonObject result;
+    result["file"] = inputFileName;
+
+    QElapsedTimer totalTimer, timer;
+    totalTimer.start();
+    timer.start();
+
+    // in streaming mode, the meshes are only ever built cluster by cluster
+    SceneFile scene(inputFileName, !options.m_stream);
+
+    result["import_ms"] = elapsedMs(timer);
+
+    if (scene.hasError()) {
+        result["status"] = QString("error");
+        result["error"] = scene.errorString();
+        printLine(result);
+        return false;
+    }
+
+    unsigned int totalFaces = 0;
+    for (unsigned int i = 0; i < scene.importedScene()->mNumMeshes; ++i) {
+        totalFaces += scene.importedScene()->mMeshes[i]->mNumFaces;
+    }
+
+    // an absolute target applies to the whole scene, so distribute it proportionally over all meshes
+    double ratio = options.m_ratio;
+    if (!options.m_useRatio) {
+        ratio = totalFaces ? std::min(1.0, double(options.m_targetFaceCount) / double(totalFaces)) : 1.0;
+    }
+
+    if (options.m_stream) {
+        QString outFileName = outputFileName(inputFileName, options);
+
+        streamScene(scene, ratio, outFileName, options, result);
+
+        bool ok = !result.contains("error");
+        result["total_ms"] = elapsedMs(totalTimer);
+        result["output"] = outFileName;
+        result["status"] = ok ? QString("ok") : QString("error");
+
+        printLine(result);
+        return ok;
+    }
+
+    std::vector<unsigned int> oldFaces;
+    for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+        oldFaces.push_back(scene.getMesh(i)->faceCount());
+    }
+
+    QString decimateError;
+    QMutex decimateErrorMutex; // the meshes are decimated by pool threads, which report their errors directly
+    std::vector<DecimationStats> meshStats;
+
+    // exportable meshes and total face count of every level of detail
+    std::vector<std::vector<aiMesh*>> lodExportMeshes(options.m_lodRatios.size());
+    std::vector<unsigned int> lodFaces(options.m_lodRatios.size(), 0);
+
+    timer.restart();
+
+    if (options.m_clusterResolution > 0) {
+        // vertex clustering is parallel within a mesh, so the meshes are processed one after the other
+        DecimationStats stats;
+
+        for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+            VertexClusterer clusterer(scene.getMesh(i), options.m_clusterResolution);
+            clusterer.start();
+
+            meshStats.push_back(clusterer.stats());
+            stats += clusterer.stats();
+        }
+
+        result["stats"] = stats.toJson();
+    } else {
+        // all meshes are decimated concurrently. the mesh decimators clean up the mesh data when they are done
+        SceneDecimator decimator(&scene, ratio, options.m_jobs);
+        decimator.setStrategy(options.m_strategy);
+        decimator.setPrecision(options.m_precision);
+        decimator.setSolver(options.m_solver);
+        decimator.setLodRatios(options.m_lodRatios);
+        QObject::connect(&decimator, &SceneDecimator::error, [&decimateError, &decimateErrorMutex] (QString msg) {
+            QMutexLocker ml(&decimateErrorMutex);
+            decimateError = msg;
+        });
+
+        decimator.start();
+
+        result["threads"] = std::min<int>(decimator.maxThreadCount(), decimator.jobCount());
+        result["stats"] = decimator.stats().toJson();
+
+        for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+            meshStats.push_back(decimator.meshStats(i));
+        }
+
+        // meshes which were not decimated are exported unchanged on every level
+        for (std::size_t l = 0; l < options.m_lodRatios.size(); ++l) {
+            for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+                const auto& lods = decimator.lodMeshes(i);
+                const Mesh* mesh = lods.empty() ? scene.getMesh(i) : lods[l].get();
+
+                lodExportMeshes[l].push_back(mesh->makeExportMesh());
+                lodFaces[l] += mesh->faceCount();
+            }
+        }
+    }
+
+    QJsonArray meshes;
+    unsigned int resultFaces = 0;
+
+    for (unsigned int i = 0; i < scene.numMeshes(); ++i) {
+        const Mesh* mesh = scene.getMesh(i);
+
+        QJsonObject meshResult;
+        meshResult["name"] = mesh->name();
+        meshResult["faces_before"] = double(oldFaces[i]);
+        meshResult["faces_after"] = double(mesh->faceCount());
+        meshResult["stats"] = meshStats[i].toJson();
+        meshes.append(meshResult);
+
+        resultFaces += mesh->faceCount();
+    }
+
+    result["decimate_ms"] = elapsedMs(timer);
+
+    QString outFileName = outputFileName(inputFileName, options);
+    QString exportError;
+
+    timer.restart();
+
+    if (options.m_lodRatios.empty()) {
+        std::vector<bool> meshMask(scene.numMeshes(), true);
+        exportError = scene.exportToFile(outFileName, options.m_formatId, meshMask);
+    } else {
+        // the last level is the final result of the decimation
+        QJsonArray lods;
+
+        for (std::size_t l = 0; l < lodExportMeshes.size(); ++l) {
+            outFileName = outputFileName(inputFileName, options, QString("_lod%1").arg(l));
+
+            QString levelError = scene.exportMeshes(outFileName, options.m_formatId, lodExportMeshes[l]);
+            if (exportError.isEmpty())
+                exportError = levelError;
+
+            QJsonObject lodResult;
+            lodResult["ratio"] = options.m_lodRatios[l];
+            lodResult["faces"] = double(lodFaces[l]);
+            lodResult["output"] = outFileName;
+            lods.append(lodResult);
+        }
+
+        result["lods"] = lods;
+    }
+
+    result["export_ms"] = elapsedMs(timer);
+    result["total_ms"] = elapsedMs(totalTimer);
+    result["output"] = outFileName;
+    result["faces_before"] = double(totalFaces);
+    result["faces_after"] = double(resultFaces);
+    result["meshes"] = meshes;
+
+    bool ok = decimateError.isEmpty() && exportError.isEmpty();
+    result["status"] = ok ? QString("ok") : QString("error");
+
+    if (!decimateError.isEmpty())
+        result["error"] = decimateError;
+    else if (!exportError.isEmpty())
+        result["error"] = exportError;
+
+    printLine(result);
+    return ok;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("meshreduce");
+    QCoreApplication::setApplicationVersion("v1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Batch mesh decimation. Prints one JSON object per input file to stdout.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption targetOption(QStringList() << "t" << "target-faces", "Target face count for each input scene.", "count");
+    QCommandLineOption ratioOption(QStringList() << "r" << "ratio", "Target face count as a fraction of the imported face count (0-1).", "ratio");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Export format id (default: obj).", "id", "obj");
+    QCommandLineOption outputOption(QStringList() << "o" << "output-dir", "Output directory (default: next to the input file).", "dir");
+    QCommandLineOption suffixOption(QStringList() << "s" << "suffix", "Suffix appended to output file names (default: _reduced).", "suffix", "_reduced");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of meshes decimated in parallel (default: number of cores).", "count", "0");
+    QCommandLineOption strategyOption("strategy", "Collapse order: greedy, multiple-choice, batched or parallel (default: greedy).", "name", "greedy");
+    QCommandLineOption precisionOption("precision", "Floating point precision of the error quadrics: single or double (default: single).", "type", "single");
+    QCommandLineOption solverOption("solver", "Vertex placement: determinant or pseudo-inverse (default: determinant).", "name", "determinant");
+    QCommandLineOption clusterOption("cluster", "Simplify by vertex clustering on a grid with the given number of cells along the longest side instead of edge collapses. "
+                                     "Very fast, but only suitable for coarse levels of detail. --target-faces and --ratio are ignored.", "cells");
+    QCommandLineOption streamOption("stream", "Decimate every mesh cluster by cluster to limit the memory usage of very large meshes.");
+    QCommandLineOption memoryBudgetOption("memory-budget", "Memory available per cluster in MiB, if --stream is set (default: 1024).", "MiB", "1024");
+    QCommandLineOption lodsOption("lods", "Comma separated target ratios of several levels of detail, which are generated in a single run and exported "
+                                  "as <name><suffix>_lod<n>. --target-faces and --ratio are ignored.", "ratios");
+    QCommandLineOption listFormatsOption("list-formats", "List available export formats and exit.");
+
+    parser.addOption(targetOption);
+    parser.addOption(ratioOption);
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(suffixOption);
+    parser.addOption(jobsOption);
+    parser.addOption(strategyOption);
+    parser.addOption(precisionOption);
+    parser.addOption(solverOption);
+    parser.addOption(clusterOption);
+    parser.addOption(streamOption);
+    parser.addOption(memoryBudgetOption);
+    parser.addOption(lodsOption);
+    parser.addOption(listFormatsOption);
+    parser.addPositionalArgument("files", "Input files to decimate.", "<files...>");
+
+    parser.process(app);
+
+    std::vector<ExportFormat> formats = SceneFile::getExportFormats();
+
+    if (parser.isSet(listFormatsOption)) {
+        QTextStream out(stdout);
+        for (const ExportFormat& format : formats) {
+            out << format.m_id << "\t" << format.m_extension << "\t" << format.m_desc << endl;
+        }
+        return 0;
+    }
+
+    Options options;
+    options.m_formatId = parser.value(formatOption);
+    options.m_outputDir = parser.value(outputOption);
+    options.m_suffix = parser.value(suffixOption);
+    options.m_targetFaceCount = 0;
+    options.m_ratio = 1.0;
+    options.m_useRatio = true;
+    options.m_jobs = parser.value(jobsOption).toInt();
+    options.m_clusterResolution = parser.value(clusterOption).toUInt();
+    options.m_stream = parser.isSet(streamOption);
+    options.m_memoryBudget = std::size_t(std::max(1u, parser.value(memoryBudgetOption).toUInt())) << 20;
+
+    QString strategy = parser.value(strategyOption);
+    QString precision = parser.value(precisionOption), solver = parser.value(solverOption);
+
+    if (strategy == "greedy") {
+        options.m_strategy = MeshDecimator::GreedyStrategy;
+    } else if (strategy == "multiple-choice") {
+        options.m_strategy = MeshDecimator::MultipleChoiceStrategy;
+    } else if (strategy == "batched") {
+        options.m_strategy = MeshDecimator::BatchedStrategy;
+    } else if (strategy == "parallel") {
+        options.m_strategy = MeshDecimator::ParallelStrategy;
+    } else {
+        printError(QString("unknown strategy \"%1\"").arg(strategy));
+        return 2;
+    }
+
+    if (precision == "single") {
+        options.m_precision = MeshDecimator::SinglePrecision;
+    } else if (precision == "double") {
+        options.m_precision = MeshDecimator::DoublePrecision;
+    } else {
+        printError(QString("unknown precision \"%1\"").arg(precision));
+        return 2;
+    }
+
+    if (solver == "determinant") {
+        options.m_solver = MeshDecimator::DeterminantSolver;
+    } else if (solver == "pseudo-inverse") {
+        options.m_solver = MeshDecimator::PseudoInverseSolver;
+    } else {
+        printError(QString("unknown solver \"%1\"").arg(solver));
+        return 2;
+    }
+
+    for (const ExportFormat& format : formats) {
+        if (format.m_id == options.m_formatId) {
+            options.m_extension = format.m_extension;
+            break;
+        }
+    }
+
+    if (options.m_extension.isEmpty()) {
+        printError(QString("unknown export format \"%1\" (see --list-formats)").arg(options.m_formatId));
+        return 2;
+    }
+
+    if (options.m_clusterResolution > 0 && options.m_stream) {
+        printError("--cluster and --stream can't be combined");
+        return 2;
+    }
+
+    if (parser.isSet(lodsOption) && (options.m_clusterResolution > 0 || options.m_stream)) {
+        printError("--lods can't be combined with --cluster or --stream");
+        return 2;
+    }
+
+    if (options.m_clusterResolution == 0 && !parser.isSet(lodsOption) && parser.isSet(targetOption) == parser.isSet(ratioOption)) {
+        printError("exactly one of --target-faces and --ratio must be given");
+        return 2;
+    }
+
+    bool ok = true;
+    if (options.m_clusterResolution > 0) {
+        // the grid resolution determines the result
+    } else if (parser.isSet(lodsOption)) {
+        for (const QString& value : parser.value(lodsOption).split(',', QString::SkipEmptyParts)) {
+            double ratio = value.toDouble(&ok);
+            if (!ok || ratio < 0.0 || ratio > 1.0) {
+                ok = false;
+                break;
+            }
+
+            options.m_lodRatios.push_back(ratio);
+        }
+
+        ok = ok && !options.m_lodRatios.empty();
+
+        // the decimation runs down to the smallest level
+        std::sort(options.m_lodRatios.begin(), options.m_lodRatios.end(), std::greater<double>());
+        options.m_ratio = ok ? options.m_lodRatios.back() : 1.0;
+    } else if (parser.isSet(targetOption)) {
+        options.m_targetFaceCount = parser.value(targetOption).toUInt(&ok);
+        options.m_useRatio = false;
+    } else {
+        options.m_ratio = parser.value(ratioOption).toDouble(&ok);
+        ok = ok && options.m_ratio >= 0.0 && options.m_ratio <= 1.0;
+    }
+
+    if (!ok) {
+        printError("invalid target face count or ratio");
+        return 2;
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        printError("no input files given");
+        return 2;
+    }
+
+    if (!options.m_outputDir.isEmpty()) {
+        QDir().mkpath(options.m_outputDir);
+    }
+
+    int failed = 0;
+    for (const QString& file : files) {
+        if (!processFile(file, options))
+            ++failed;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -3,6 +3,7 @@
 #include "scenefile.hpp"
 #include "mesh.hpp"
 #include "mesh_decimator.hpp"
+#include "scene_decimator.hpp"
 #include "exportdialog.hpp"
 
 #include <QtWidgets\QFileDialog>
@@ -21,6 +22,9 @@ MeshReduction::MeshReduction(QWidget *parent) : QMainWindow(parent), m_isDecimat
 
 	ui.setupUi(this);
 
+    // decimation stats are sent across threads
+    qRegisterMetaType<DecimationStats>();
+
 	m_glWidget = ui.openGLWidget;
 
     ui.actionDraw_Faces->setChecked(m_glWidget->drawFaces());
@@ -48,6 +52,7 @@ MeshReduction::MeshReduction(QWidget *parent) : QMainWindow(parent), m_isDecimat
     connect(ui.actionReset_Mesh, SIGNAL(triggered(bool)), this, SLOT(resetMesh()));
 
     connect(ui.decimateButton, SIGNAL(clicked(bool)), this, SLOT(decimateMesh()));
+    connect(ui.actionDecimate_All, SIGNAL(triggered(bool)), this, SLOT(decimateAllMeshes()));
     connect(ui.resetButton, SIGNAL(clicked(bool)), this, SLOT(resetMesh()));
 
     connect(ui.targetFaceCount, SIGNAL(editingFinished()), this, SLOT(onSetTargetFaceCount()));
@@ -236,30 +241,44 @@ void MeshReduction::resetMesh()
 void MeshReduction::decimateMesh()
 {
     if ((m_selectedMesh != nullptr) && !m_isDecimating) {
-        m_progressDialog.reset(new QProgressDialog(tr("Decimating Mesh..."), tr("Abort"), 0, 100, this));
-        m_progressDialog->setWindowModality(Qt::WindowModal);
-        m_progressDialog->setMinimumDuration(2000);
-        m_progressDialog->setValue(0);
+        runDecimator(new MeshDecimator(m_selectedMesh, targetFaceCount()), tr("Decimating Mesh..."));
+    }
+}
+
+void MeshReduction::decimateAllMeshes()
+{
+    if (m_currentFile && !m_isDecimating) {
+        double ratio = ui.percentageBox->value() * 0.01;
+        runDecimator(new SceneDecimator(m_currentFile.get(), ratio), tr("Decimating All Meshes..."));
+    }
+}
 
-        QThread* thread = new QThread(this);
-        MeshDecimator* decimator = new MeshDecimator(m_selectedMesh, targetFaceCount());
+void MeshReduction::runDecimator(QObject *decimator, const QString &label)
+{
+    // decimator is either a MeshDecimator or a SceneDecimator, both provide the same slots and signals
+    m_progressDialog.reset(new QProgressDialog(label, tr("Abort"), 0, 100, this));
+    m_progressDialog->setWindowModality(Qt::WindowModal);
+    m_progressDialog->setMinimumDuration(2000);
+    m_progressDialog->setValue(0);
 
-        decimator->moveToThread(thread);
+    QThread* thread = new QThread(this);
 
-        connect(thread, SIGNAL(started()), decimator, SLOT(start()));
-        connect(decimator, SIGNAL(finished()), thread, SLOT(quit()));
-        connect(decimator, SIGNAL(progressChanged(float)), this, SLOT(onDecimateProgress(float)));
-        connect(thread, SIGNAL(finished()), decimator, SLOT(deleteLater()));
-        connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
-        connect(thread, SIGNAL(finished()), this, SLOT(onFinishDecimating()));
+    decimator->moveToThread(thread);
 
-        connect(m_progressDialog.get(), SIGNAL(canceled()), decimator, SLOT(abort()), Qt::DirectConnection);
+    connect(thread, SIGNAL(started()), decimator, SLOT(start()));
+    connect(decimator, SIGNAL(finished()), thread, SLOT(quit()));
+    connect(decimator, SIGNAL(progressChanged(float)), this, SLOT(onDecimateProgress(float)));
+    connect(decimator, SIGNAL(statsAvailable(DecimationStats)), this, SLOT(onDecimateStats(DecimationStats)));
+    connect(thread, SIGNAL(finished()), decimator, SLOT(deleteLater()));
+    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    connect(thread, SIGNAL(finished()), this, SLOT(onFinishDecimating()));
 
-        connect(thread, SIGNAL(started()), this, SLOT(onStartDecimating()));
-        connect(thread, SIGNAL(finished()), this, SLOT(onFinishDecimating()));
+    connect(m_progressDialog.get(), SIGNAL(canceled()), decimator, SLOT(abort()), Qt::DirectConnection);
 
-        thread->start();
-    }
+    connect(thread, SIGNAL(started()), this, SLOT(onStartDecimating()));
+    connect(thread, SIGNAL(finished()), this, SLOT(onFinishDecimating()));
+
+    thread->start();
 }
 
 void MeshReduction::onDecimateProgress(float value)
@@ -270,8 +289,15 @@ void MeshReduction::onDecimateProgress(float value)
     }
 }
 
+void MeshReduction::onDecimateStats(const DecimationStats &stats)
+{
+    m_decimationSummary = stats.summary();
+}
+
 void MeshReduction::onStartDecimating()
 {
+    m_decimationSummary.clear();
+
     statusBar()->showMessage(tr("Started decimating..."));
     setIsDecimating(true);
 }
@@ -282,7 +308,10 @@ void MeshReduction::onFinishDecimating()
 
     m_progressDialog.reset();
 
-    statusBar()->showMessage(tr("Finished decimating."));
+    if (m_decimationSummary.isEmpty())
+        statusBar()->showMessage(tr("Finished decimating."));
+    else
+        statusBar()->showMessage(tr("Finished decimating: %1").arg(m_decimationSummary));
 
     emit meshChanged();
 }
@@ -360,6 +389,7 @@ void MeshReduction::setIsDecimating(bool value)
     ui.decimateButton->setEnabled(!value);
     ui.resetButton->setEnabled(!value);
     ui.actionReset_Mesh->setEnabled(!value);
+    ui.actionDecimate_All->setEnabled(!value);
 }
 
 void MeshReduction::openFile()
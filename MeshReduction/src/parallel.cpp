@@ -0,0 +1,111 @@
+#include "parallel.hpp"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+// number of chunks per thread, so that threads finishing early can help out with the remaining work
+#define CHUNKS_PER_THREAD 4
+
+namespace
+{
+
+/*!
+ * \brief state shared between the calling thread and all pool threads working on a parallel_for
+ *
+ * Pool threads may only start running after the range has been processed completely, so the state is reference counted
+ * and fn must not be accessed by a thread that did not claim a chunk.
+ */
+struct ParallelForState
+{
+    const std::function<void(std::size_t, std::size_t)>* m_fn;
+    std::size_t m_count, m_chunkSize, m_chunkCount;
+
+    std::atomic<std::size_t> m_nextChunk, m_finishedChunks;
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+
+    ParallelForState(const std::function<void(std::size_t, std::size_t)>& fn, std::size_t count, std::size_t chunkSize) :
+        m_fn(&fn), m_count(count), m_chunkSize(chunkSize), m_chunkCount((count + chunkSize - 1) / chunkSize),
+        m_nextChunk(0), m_finishedChunks(0) { }
+
+    /*!
+     * \brief claims and processes the next chunk
+     * \return false if there were no chunks left
+     */
+    bool runChunk()
+    {
+        std::size_t c = m_nextChunk++;
+        if (c >= m_chunkCount)
+            return false;
+
+        std::size_t begin = c * m_chunkSize;
+        (*m_fn)(begin, std::min(begin + m_chunkSize, m_count));
+
+        if (++m_finishedChunks == m_chunkCount) {
+            QMutexLocker ml(&m_mutex);
+            m_finished.wakeAll();
+        }
+
+        return true;
+    }
+
+    void wait()
+    {
+        QMutexLocker ml(&m_mutex);
+        while (m_finishedChunks.load() < m_chunkCount) {
+            m_finished.wait(&m_mutex);
+        }
+    }
+};
+
+class ParallelForRunnable : public QRunnable
+{
+private:
+    std::shared_ptr<ParallelForState> m_state;
+
+public:
+    ParallelForRunnable(const std::shared_ptr<ParallelForState>& state) : m_state(state) { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        while (m_state->runChunk());
+    }
+};
+
+}
+
+void parallel_for(std::size_t count, const std::function<void(std::size_t, std::size_t)>& fn, std::size_t grainSize)
+{
+    if (count == 0)
+        return;
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    std::size_t threadCount = std::max(1, pool->maxThreadCount());
+    grainSize = std::max<std::size_t>(1, grainSize);
+
+    if (threadCount == 1 || count <= grainSize) {
+        fn(0, count);
+        return;
+    }
+
+    std::size_t chunkCount = threadCount * CHUNKS_PER_THREAD;
+    std::size_t chunkSize = std::max(grainSize, (count + chunkCount - 1) / chunkCount);
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>(fn, count, chunkSize);
+
+    std::size_t helperCount = std::min(threadCount, state->m_chunkCount) - 1;
+    for (std::size_t i = 0; i < helperCount; ++i) {
+        pool->start(new ParallelForRunnable(state));
+    }
+
+    while (state->runChunk());
+
+    state->wait();
+}
@@ -0,0 +1,347 @@
+#include "quadric_batch.hpp"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QUADRIC_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// functions using AVX instructions are only called after checking for CPU support, so they have to be compiled for AVX
+// regardless of the global compiler flags (MSVC always allows AVX intrinsics)
+#if defined(QUADRIC_BATCH_X86) && defined(__GNUC__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+namespace
+{
+
+std::atomic<int> g_simdLevel(-1); // -1: not initialized yet
+
+SimdLevel detectSimdLevel()
+{
+#ifdef QUADRIC_BATCH_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    // the OS must save the AVX registers on context switches as well
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        return SimdAVX;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        return SimdAVX;
+#endif
+    return SimdSSE; // part of every x86-64 CPU
+#else
+    return SimdScalar;
+#endif
+}
+
+struct Components
+{
+    const float *a11, *a12, *a13, *a22, *a23, *a33, *b1, *b2, *b3, *c;
+
+    Components(const quadric_batch& batch) :
+        a11(batch.component(quadric_batch::A11)), a12(batch.component(quadric_batch::A12)),
+        a13(batch.component(quadric_batch::A13)), a22(batch.component(quadric_batch::A22)),
+        a23(batch.component(quadric_batch::A23)), a33(batch.component(quadric_batch::A33)),
+        b1(batch.component(quadric_batch::B1)), b2(batch.component(quadric_batch::B2)),
+        b3(batch.component(quadric_batch::B3)), c(batch.component(quadric_batch::C)) { }
+};
+
+// scalar code paths (same order of operations as Quadric::optimum and Quadric::operator())
+
+void optimumScalar(const Components& q, std::size_t begin, std::size_t end, glm::vec3* positions, float* costs, unsigned char* solved)
+{
+    for (std::size_t i = begin; i < end; ++i) {
+        float c11 = q.a22[i] * q.a33[i] - q.a23[i] * q.a23[i];
+        float c12 = q.a13[i] * q.a23[i] - q.a12[i] * q.a33[i];
+        float c13 = q.a12[i] * q.a23[i] - q.a13[i] * q.a22[i];
+        float c22 = q.a11[i] * q.a33[i] - q.a13[i] * q.a13[i];
+        float c23 = q.a12[i] * q.a13[i] - q.a11[i] * q.a23[i];
+        float c33 = q.a11[i] * q.a22[i] - q.a12[i] * q.a12[i];
+
+        float det = q.a11[i] * c11 + q.a12[i] * c12 + q.a13[i] * c13;
+
+        solved[i] = std::abs(det) >= quadric_min_det;
+
+        float s = -1.0f / det;
+        float x = (c11 * q.b1[i] + c12 * q.b2[i] + c13 * q.b3[i]) * s;
+        float y = (c12 * q.b1[i] + c22 * q.b2[i] + c23 * q.b3[i]) * s;
+        float z = (c13 * q.b1[i] + c23 * q.b2[i] + c33 * q.b3[i]) * s;
+
+        positions[i] = glm::vec3(x, y, z);
+        costs[i] = q.b1[i] * x + q.b2[i] * y + q.b3[i] * z + q.c[i];
+    }
+}
+
+void evaluateScalar(const Components& q, std::size_t begin, std::size_t end, const glm::vec3* positions, float* costs)
+{
+    for (std::size_t i = begin; i < end; ++i) {
+        float x = positions[i].x, y = positions[i].y, z = positions[i].z;
+
+        float ax = q.a11[i] * x + q.a12[i] * y + q.a13[i] * z;
+        float ay = q.a12[i] * x + q.a22[i] * y + q.a23[i] * z;
+        float az = q.a13[i] * x + q.a23[i] * y + q.a33[i] * z;
+        float bv = q.b1[i] * x + q.b2[i] * y + q.b3[i] * z;
+
+        costs[i] = x * ax + y * ay + z * az + 2.0f * bv + q.c[i];
+    }
+}
+
+#ifdef QUADRIC_BATCH_X86
+
+// SSE code paths
+
+std::size_t optimumSSE(const Components& q, std::size_t count, glm::vec3* positions, float* costs, unsigned char* solved)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f), minDet = _mm_set1_ps(quadric_min_det), minusOne = _mm_set1_ps(-1.0f);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 a11 = _mm_loadu_ps(q.a11 + i), a12 = _mm_loadu_ps(q.a12 + i), a13 = _mm_loadu_ps(q.a13 + i);
+        __m128 a22 = _mm_loadu_ps(q.a22 + i), a23 = _mm_loadu_ps(q.a23 + i), a33 = _mm_loadu_ps(q.a33 + i);
+        __m128 b1 = _mm_loadu_ps(q.b1 + i), b2 = _mm_loadu_ps(q.b2 + i), b3 = _mm_loadu_ps(q.b3 + i);
+
+        __m128 c11 = _mm_sub_ps(_mm_mul_ps(a22, a33), _mm_mul_ps(a23, a23));
+        __m128 c12 = _mm_sub_ps(_mm_mul_ps(a13, a23), _mm_mul_ps(a12, a33));
+        __m128 c13 = _mm_sub_ps(_mm_mul_ps(a12, a23), _mm_mul_ps(a13, a22));
+        __m128 c22 = _mm_sub_ps(_mm_mul_ps(a11, a33), _mm_mul_ps(a13, a13));
+        __m128 c23 = _mm_sub_ps(_mm_mul_ps(a12, a13), _mm_mul_ps(a11, a23));
+        __m128 c33 = _mm_sub_ps(_mm_mul_ps(a11, a22), _mm_mul_ps(a12, a12));
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a11, c11), _mm_mul_ps(a12, c12)), _mm_mul_ps(a13, c13));
+        int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_andnot_ps(signMask, det), minDet));
+
+        __m128 s = _mm_div_ps(minusOne, det);
+        __m128 x = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c11, b1), _mm_mul_ps(c12, b2)), _mm_mul_ps(c13, b3)), s);
+        __m128 y = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c12, b1), _mm_mul_ps(c22, b2)), _mm_mul_ps(c23, b3)), s);
+        __m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c13, b1), _mm_mul_ps(c23, b2)), _mm_mul_ps(c33, b3)), s);
+
+        __m128 cost = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(b1, x), _mm_mul_ps(b2, y)), _mm_mul_ps(b3, z)), _mm_loadu_ps(q.c + i));
+        _mm_storeu_ps(costs + i, cost);
+
+        float xs[4], ys[4], zs[4];
+        _mm_storeu_ps(xs, x);
+        _mm_storeu_ps(ys, y);
+        _mm_storeu_ps(zs, z);
+
+        for (int k = 0; k < 4; ++k) {
+            positions[i + k] = glm::vec3(xs[k], ys[k], zs[k]);
+            solved[i + k] = (mask >> k) & 1;
+        }
+    }
+
+    return i;
+}
+
+std::size_t evaluateSSE(const Components& q, std::size_t count, const glm::vec3* positions, float* costs)
+{
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const glm::vec3* p = positions + i;
+        __m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+        __m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+        __m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+
+        __m128 a11 = _mm_loadu_ps(q.a11 + i), a12 = _mm_loadu_ps(q.a12 + i), a13 = _mm_loadu_ps(q.a13 + i);
+        __m128 a22 = _mm_loadu_ps(q.a22 + i), a23 = _mm_loadu_ps(q.a23 + i), a33 = _mm_loadu_ps(q.a33 + i);
+
+        __m128 ax = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a11, x), _mm_mul_ps(a12, y)), _mm_mul_ps(a13, z));
+        __m128 ay = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a12, x), _mm_mul_ps(a22, y)), _mm_mul_ps(a23, z));
+        __m128 az = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a13, x), _mm_mul_ps(a23, y)), _mm_mul_ps(a33, z));
+        __m128 bv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q.b1 + i), x), _mm_mul_ps(_mm_loadu_ps(q.b2 + i), y)),
+                               _mm_mul_ps(_mm_loadu_ps(q.b3 + i), z));
+
+        __m128 cost = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, ax), _mm_mul_ps(y, ay)), _mm_mul_ps(z, az));
+        cost = _mm_add_ps(_mm_add_ps(cost, _mm_mul_ps(two, bv)), _mm_loadu_ps(q.c + i));
+
+        _mm_storeu_ps(costs + i, cost);
+    }
+
+    return i;
+}
+
+// AVX code paths
+
+TARGET_AVX std::size_t optimumAVX(const Components& q, std::size_t count, glm::vec3* positions, float* costs, unsigned char* solved)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f), minDet = _mm256_set1_ps(quadric_min_det), minusOne = _mm256_set1_ps(-1.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 a11 = _mm256_loadu_ps(q.a11 + i), a12 = _mm256_loadu_ps(q.a12 + i), a13 = _mm256_loadu_ps(q.a13 + i);
+        __m256 a22 = _mm256_loadu_ps(q.a22 + i), a23 = _mm256_loadu_ps(q.a23 + i), a33 = _mm256_loadu_ps(q.a33 + i);
+        __m256 b1 = _mm256_loadu_ps(q.b1 + i), b2 = _mm256_loadu_ps(q.b2 + i), b3 = _mm256_loadu_ps(q.b3 + i);
+
+        __m256 c11 = _mm256_sub_ps(_mm256_mul_ps(a22, a33), _mm256_mul_ps(a23, a23));
+        __m256 c12 = _mm256_sub_ps(_mm256_mul_ps(a13, a23), _mm256_mul_ps(a12, a33));
+        __m256 c13 = _mm256_sub_ps(_mm256_mul_ps(a12, a23), _mm256_mul_ps(a13, a22));
+        __m256 c22 = _mm256_sub_ps(_mm256_mul_ps(a11, a33), _mm256_mul_ps(a13, a13));
+        __m256 c23 = _mm256_sub_ps(_mm256_mul_ps(a12, a13), _mm256_mul_ps(a11, a23));
+        __m256 c33 = _mm256_sub_ps(_mm256_mul_ps(a11, a22), _mm256_mul_ps(a12, a12));
+
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a11, c11), _mm256_mul_ps(a12, c12)), _mm256_mul_ps(a13, c13));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(signMask, det), minDet, _CMP_GE_OQ));
+
+        __m256 s = _mm256_div_ps(minusOne, det);
+        __m256 x = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c11, b1), _mm256_mul_ps(c12, b2)), _mm256_mul_ps(c13, b3)), s);
+        __m256 y = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c12, b1), _mm256_mul_ps(c22, b2)), _mm256_mul_ps(c23, b3)), s);
+        __m256 z = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c13, b1), _mm256_mul_ps(c23, b2)), _mm256_mul_ps(c33, b3)), s);
+
+        __m256 cost = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b1, x), _mm256_mul_ps(b2, y)), _mm256_mul_ps(b3, z)),
+                                    _mm256_loadu_ps(q.c + i));
+        _mm256_storeu_ps(costs + i, cost);
+
+        float xs[8], ys[8], zs[8];
+        _mm256_storeu_ps(xs, x);
+        _mm256_storeu_ps(ys, y);
+        _mm256_storeu_ps(zs, z);
+
+        for (int k = 0; k < 8; ++k) {
+            positions[i + k] = glm::vec3(xs[k], ys[k], zs[k]);
+            solved[i + k] = (mask >> k) & 1;
+        }
+    }
+
+    return i;
+}
+
+TARGET_AVX std::size_t evaluateAVX(const Components& q, std::size_t count, const glm::vec3* positions, float* costs)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const glm::vec3* p = positions + i;
+        __m256 x = _mm256_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+        __m256 y = _mm256_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+        __m256 z = _mm256_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z, p[4].z, p[5].z, p[6].z, p[7].z);
+
+        __m256 a11 = _mm256_loadu_ps(q.a11 + i), a12 = _mm256_loadu_ps(q.a12 + i), a13 = _mm256_loadu_ps(q.a13 + i);
+        __m256 a22 = _mm256_loadu_ps(q.a22 + i), a23 = _mm256_loadu_ps(q.a23 + i), a33 = _mm256_loadu_ps(q.a33 + i);
+
+        __m256 ax = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a11, x), _mm256_mul_ps(a12, y)), _mm256_mul_ps(a13, z));
+        __m256 ay = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a12, x), _mm256_mul_ps(a22, y)), _mm256_mul_ps(a23, z));
+        __m256 az = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a13, x), _mm256_mul_ps(a23, y)), _mm256_mul_ps(a33, z));
+        __m256 bv = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(q.b1 + i), x), _mm256_mul_ps(_mm256_loadu_ps(q.b2 + i), y)),
+                                  _mm256_mul_ps(_mm256_loadu_ps(q.b3 + i), z));
+
+        __m256 cost = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, ax), _mm256_mul_ps(y, ay)), _mm256_mul_ps(z, az));
+        cost = _mm256_add_ps(_mm256_add_ps(cost, _mm256_mul_ps(two, bv)), _mm256_loadu_ps(q.c + i));
+
+        _mm256_storeu_ps(costs + i, cost);
+    }
+
+    return i;
+}
+
+#endif
+
+}
+
+void quadric_batch::reserve(std::size_t n)
+{
+    for (std::vector<float>& d : m_data) {
+        d.reserve(n);
+    }
+}
+
+void quadric_batch::clear()
+{
+    for (std::vector<float>& d : m_data) {
+        d.clear();
+    }
+}
+
+void quadric_batch::push_back(const Quadric &Q)
+{
+    for (int i = 0; i < 6; ++i) {
+        m_data[A11 + i].push_back(Q.m_A.m_data[i]);
+    }
+
+    m_data[B1].push_back(Q.m_b.x);
+    m_data[B2].push_back(Q.m_b.y);
+    m_data[B3].push_back(Q.m_b.z);
+    m_data[C].push_back(Q.m_c);
+}
+
+void quadric_batch::optimum(glm::vec3 *positions, float *costs, unsigned char *solved) const
+{
+    Components q(*this);
+    std::size_t done = 0;
+
+#ifdef QUADRIC_BATCH_X86
+    switch (simdLevel()) {
+    case SimdAVX: done = optimumAVX(q, size(), positions, costs, solved); break;
+    case SimdSSE: done = optimumSSE(q, size(), positions, costs, solved); break;
+    default: break;
+    }
+#endif
+
+    optimumScalar(q, done, size(), positions, costs, solved);
+}
+
+void quadric_batch::evaluate(const glm::vec3 *positions, float *costs) const
+{
+    Components q(*this);
+    std::size_t done = 0;
+
+#ifdef QUADRIC_BATCH_X86
+    switch (simdLevel()) {
+    case SimdAVX: done = evaluateAVX(q, size(), positions, costs); break;
+    case SimdSSE: done = evaluateSSE(q, size(), positions, costs); break;
+    default: break;
+    }
+#endif
+
+    evaluateScalar(q, done, size(), positions, costs);
+}
+
+SimdLevel quadric_batch::supportedSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+SimdLevel quadric_batch::simdLevel()
+{
+    int level = g_simdLevel.load(std::memory_order_relaxed);
+    if (level < 0) {
+        level = supportedSimdLevel();
+        g_simdLevel.store(level, std::memory_order_relaxed);
+    }
+
+    return SimdLevel(level);
+}
+
+void quadric_batch::setSimdLevel(SimdLevel level)
+{
+    if (level > supportedSimdLevel())
+        level = supportedSimdLevel();
+
+    g_simdLevel.store(level, std::memory_order_relaxed);
+}
+
+const char *quadric_batch::simdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdScalar: return "scalar";
+    case SimdSSE: return "sse";
+    case SimdAVX: return "avx";
+    }
+    return "";
+}
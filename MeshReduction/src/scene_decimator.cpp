@@ -0,0 +1,186 @@
+#include "scene_decimator.hpp"
+#include "scenefile.hpp"
+#include "mesh.hpp"
+#include "mesh_decimator.hpp"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <algorithm>
+#include <cmath>
+
+// aggregated progress is only signalled in steps of this size
+#define PROGRESS_STEPS 200
+
+class SceneDecimator::Worker : public QRunnable
+{
+private:
+    SceneDecimator* m_owner;
+
+public:
+    Worker(SceneDecimator* owner) : m_owner(owner) { }
+
+    void run() Q_DECL_OVERRIDE { m_owner->runJobs(); }
+};
+
+SceneDecimator::SceneDecimator(SceneFile *scene, double targetRatio, int maxThreadCount) :
+    m_totalWeight(0), m_maxThreadCount(maxThreadCount),
+    m_strategy(MeshDecimator::GreedyStrategy), m_precision(MeshDecimator::SinglePrecision), m_solver(MeshDecimator::DeterminantSolver), m_nextJob(0), m_abort(false), m_lastProgressStep(-1)
+{
+    if (m_maxThreadCount <= 0) {
+        m_maxThreadCount = std::max(1, QThread::idealThreadCount());
+    }
+
+    for (unsigned int i = 0; i < scene->numMeshes(); ++i) {
+        Mesh* mesh = scene->getMesh(i);
+        unsigned int faces = mesh->importedFaceCount();
+        unsigned int target = static_cast<unsigned int>(std::lround(faces * targetRatio));
+
+        if (target < faces) {
+            m_jobs.push_back({mesh, i, target, faces - target});
+            m_totalWeight += faces - target;
+        }
+    }
+
+    m_meshStats.resize(scene->numMeshes());
+    m_lodMeshes.resize(scene->numMeshes());
+
+    // schedule the largest meshes first, so that the small ones can fill the gaps at the end
+    std::stable_sort(m_jobs.begin(), m_jobs.end(), [] (const Job& lhs, const Job& rhs) {
+        return lhs.m_mesh->importedFaceCount() > rhs.m_mesh->importedFaceCount();
+    });
+
+    m_jobProgress.reset(new std::atomic<float>[m_jobs.size()]);
+    for (std::size_t j = 0; j < m_jobs.size(); ++j) {
+        m_jobProgress[j] = 0.0f;
+    }
+}
+
+SceneDecimator::~SceneDecimator() { }
+
+float SceneDecimator::progress() const
+{
+    if (m_totalWeight == 0)
+        return 1.0f;
+
+    double sum = 0.0;
+    for (std::size_t j = 0; j < m_jobs.size(); ++j) {
+        sum += double(m_jobs[j].m_weight) * m_jobProgress[j].load(std::memory_order_relaxed);
+    }
+
+    return float(sum / double(m_totalWeight));
+}
+
+bool SceneDecimator::isAborting() const
+{
+    return m_abort.load();
+}
+
+void SceneDecimator::abort()
+{
+    m_abort = true;
+
+    QMutexLocker ml(&m_mutex);
+
+    for (MeshDecimator* decimator : m_activeDecimators) {
+        decimator->abort();
+    }
+}
+
+void SceneDecimator::setJobProgress(std::size_t j, float value)
+{
+    if (!(value >= 0.0f && value <= 1.0f))
+        return;
+
+    m_jobProgress[j].store(value, std::memory_order_relaxed);
+
+    float p = progress();
+    int step = int(p * PROGRESS_STEPS);
+    int last = m_lastProgressStep.load();
+
+    // only the thread that advances the step emits the signal
+    while (step > last) {
+        if (m_lastProgressStep.compare_exchange_weak(last, step)) {
+            emit progressChanged(p);
+            break;
+        }
+    }
+}
+
+void SceneDecimator::runJob(std::size_t j)
+{
+    const Job& job = m_jobs[j];
+
+    MeshDecimator decimator(job.m_mesh, job.m_targetFaceCount);
+    decimator.setStrategy(m_strategy);
+    decimator.setPrecision(m_precision);
+    decimator.setSolver(m_solver);
+
+    if (!m_lodRatios.empty()) {
+        std::vector<unsigned int> lodFaceCounts;
+        for (double ratio : m_lodRatios) {
+            lodFaceCounts.push_back(static_cast<unsigned int>(std::lround(job.m_mesh->importedFaceCount() * ratio)));
+        }
+
+        decimator.setLodFaceCounts(std::move(lodFaceCounts));
+    }
+
+    // the worker threads have no event loop, so all connections must be direct
+    connect(&decimator, &MeshDecimator::progressChanged, [this, j] (float value) {
+        setJobProgress(j, value);
+    });
+    connect(&decimator, &MeshDecimator::error, this, &SceneDecimator::error, Qt::DirectConnection);
+
+    {
+        QMutexLocker ml(&m_mutex);
+        m_activeDecimators.push_back(&decimator);
+    }
+
+    if (!isAborting()) {
+        decimator.start();
+    }
+
+    {
+        QMutexLocker ml(&m_mutex);
+        m_activeDecimators.erase(std::find(m_activeDecimators.begin(), m_activeDecimators.end(), &decimator));
+    }
+
+    m_meshStats[job.m_meshIndex] = decimator.stats();
+    m_lodMeshes[job.m_meshIndex] = decimator.takeLodMeshes();
+
+    setJobProgress(j, 1.0f);
+}
+
+void SceneDecimator::runJobs()
+{
+    while (!isAborting()) {
+        std::size_t j = m_nextJob++;
+        if (j >= m_jobs.size())
+            break;
+
+        runJob(j);
+    }
+}
+
+void SceneDecimator::start()
+{
+    int threadCount = std::min<int>(m_maxThreadCount, m_jobs.size());
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::max(1, threadCount));
+
+    for (int i = 0; i < threadCount; ++i) {
+        pool.start(new Worker(this));
+    }
+
+    pool.waitForDone();
+
+    m_stats = DecimationStats();
+    for (const DecimationStats& stats : m_meshStats) {
+        m_stats += stats;
+    }
+
+    emit statsAvailable(m_stats);
+    emit finished();
+}
@@ -8,7 +8,7 @@
 
 #include <assimp/Exporter.hpp>
 
-SceneFile::SceneFile(const QString& fileName) : m_fileName(fileName)
+SceneFile::SceneFile(const QString& fileName, bool buildMeshes) : m_fileName(fileName)
 {
     unsigned int pFlags = aiProcess_GenNormals
             | aiProcess_JoinIdenticalVertices
@@ -23,7 +23,7 @@ SceneFile::SceneFile(const QString& fileName) : m_fileName(fileName)
 
     m_importedScene = m_importer.ReadFile(m_fileName.toLatin1().data(), pFlags);
 
-    if (m_importedScene) {
+    if (m_importedScene && buildMeshes) {
         for (unsigned int i = 0; i < m_importedScene->mNumMeshes; ++i) {
             m_meshes.emplace_back(new Mesh(m_importedScene->mMeshes[i]));
         }
@@ -32,8 +32,6 @@ SceneFile::SceneFile(const QString& fileName) : m_fileName(fileName)
 
 QString SceneFile::exportToFile(const QString &fileName, const QString &formatId, const std::vector<bool> &includedMeshMask) const
 {
-    aiScene exportedScene;
-
     std::vector<aiMesh*> exportedMeshes;
 
     for (unsigned int i = 0; i < numMeshes(); ++i) {
@@ -42,7 +40,14 @@ QString SceneFile::exportToFile(const QString &fileName, const QString &formatId
         }
     }
 
-    unsigned int nm = exportedMeshes.size();
+    return exportMeshes(fileName, formatId, exportedMeshes);
+}
+
+QString SceneFile::exportMeshes(const QString &fileName, const QString &formatId, const std::vector<aiMesh*> &meshes) const
+{
+    aiScene exportedScene; // deletes the meshes
+
+    unsigned int nm = meshes.size();
 
     exportedScene.mRootNode = new aiNode();
     exportedScene.mRootNode->mNumMeshes = nm;
@@ -52,7 +57,7 @@ QString SceneFile::exportToFile(const QString &fileName, const QString &formatId
     exportedScene.mMeshes = new aiMesh*[nm];
 
     for (unsigned int i = 0; i < nm; ++i) {
-        exportedScene.mMeshes[i] = exportedMeshes[i];
+        exportedScene.mMeshes[i] = meshes[i];
         exportedScene.mRootNode->mMeshes[i] = i;
     }
 
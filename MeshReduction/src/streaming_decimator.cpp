@@ -0,0 +1,320 @@
+#include "streaming_decimator.hpp"
+#include "mesh.hpp"
+#include "mesh_decimator.hpp"
+
+#include <assimp/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// rough upper bound of the memory needed per face by the cluster copy of the imported data, Mesh and MeshDecimator
+#define CLUSTER_BYTES_PER_FACE 512
+
+StreamingDecimator::StreamingDecimator(const aiMesh *mesh, unsigned int targetFaceCount, std::size_t memoryBudget) :
+    m_mesh(mesh), m_targetFaceCount(targetFaceCount), m_memoryBudget(memoryBudget),
+    m_strategy(MeshDecimator::GreedyStrategy), m_precision(MeshDecimator::SinglePrecision), m_solver(MeshDecimator::DeterminantSolver),
+    m_abort(false), m_finishedFaces(0), m_progress(0.0f), m_activeDecimator(nullptr)
+{ }
+
+StreamingDecimator::~StreamingDecimator() { }
+
+float StreamingDecimator::progress() const
+{
+    return m_progress.load();
+}
+
+bool StreamingDecimator::isAborting() const
+{
+    return m_abort.load();
+}
+
+void StreamingDecimator::abort()
+{
+    m_abort = true;
+
+    QMutexLocker ml(&m_mutex);
+
+    if (m_activeDecimator)
+        m_activeDecimator->abort();
+}
+
+glm::vec3 StreamingDecimator::faceCenter(unsigned int f) const
+{
+    const aiFace& face = m_mesh->mFaces[f];
+    const aiVector3D& p0 = m_mesh->mVertices[face.mIndices[0]];
+    const aiVector3D& p1 = m_mesh->mVertices[face.mIndices[1]];
+    const aiVector3D& p2 = m_mesh->mVertices[face.mIndices[2]];
+
+    return glm::vec3(p0.x + p1.x + p2.x, p0.y + p1.y + p2.y, p0.z + p1.z + p2.z) / 3.0f;
+}
+
+void StreamingDecimator::partition()
+{
+    std::size_t maxClusterFaces = std::max<std::size_t>(1, m_memoryBudget / CLUSTER_BYTES_PER_FACE);
+
+    m_faceOrder.resize(m_mesh->mNumFaces);
+    for (unsigned int f = 0; f < m_mesh->mNumFaces; ++f) {
+        m_faceOrder[f] = f;
+    }
+
+    m_clusters.clear();
+
+    // split the face ranges at the median of their longest axis until they are small enough (depth first, so that
+    // neighbouring clusters are processed one after the other)
+    std::vector<Cluster> ranges;
+    ranges.push_back({0, m_faceOrder.size()});
+
+    while (!ranges.empty()) {
+        Cluster range = ranges.back();
+        ranges.pop_back();
+
+        if (range.m_faceCount <= maxClusterFaces) {
+            if (range.m_faceCount > 0)
+                m_clusters.push_back(range);
+
+            continue;
+        }
+
+        auto begin = m_faceOrder.begin() + range.m_firstFace;
+        auto end = begin + range.m_faceCount;
+
+        glm::vec3 lower(faceCenter(*begin)), upper(lower);
+        for (auto it = begin; it != end; ++it) {
+            glm::vec3 c = faceCenter(*it);
+            lower = glm::min(lower, c);
+            upper = glm::max(upper, c);
+        }
+
+        glm::vec3 extent = upper - lower;
+        int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        std::size_t half = range.m_faceCount / 2;
+        std::nth_element(begin, begin + half, end, [this, axis] (unsigned int lhs, unsigned int rhs) {
+            return faceCenter(lhs)[axis] < faceCenter(rhs)[axis];
+        });
+
+        // the lower half is processed first
+        ranges.push_back({range.m_firstFace + half, range.m_faceCount - half});
+        ranges.push_back({range.m_firstFace, half});
+    }
+}
+
+void StreamingDecimator::lockSharedVertices()
+{
+    // cluster which first used every vertex
+    std::vector<unsigned int> vertexClusters(m_mesh->mNumVertices, unsigned(-1));
+    m_lockedVertices.assign(m_mesh->mNumVertices, false);
+
+    for (unsigned int c = 0; c < m_clusters.size(); ++c) {
+        const Cluster& cluster = m_clusters[c];
+
+        for (std::size_t i = cluster.m_firstFace; i < cluster.m_firstFace + cluster.m_faceCount; ++i) {
+            const aiFace& face = m_mesh->mFaces[m_faceOrder[i]];
+
+            for (unsigned int j = 0; j < 3; ++j) {
+                unsigned int v = face.mIndices[j];
+
+                if (vertexClusters[v] == unsigned(-1))
+                    vertexClusters[v] = c;
+                else if (vertexClusters[v] != c)
+                    m_lockedVertices[v] = true;
+            }
+        }
+    }
+}
+
+void StreamingDecimator::decimateCluster(const Cluster& cluster)
+{
+    // copy the faces of the cluster and the vertices they use into a mesh of their own
+    std::vector<unsigned int> clusterVertices; // imported index of every vertex of the cluster
+    std::vector<bool> locked;
+
+    for (std::size_t i = cluster.m_firstFace; i < cluster.m_firstFace + cluster.m_faceCount; ++i) {
+        const aiFace& face = m_mesh->mFaces[m_faceOrder[i]];
+
+        for (unsigned int j = 0; j < 3; ++j) {
+            unsigned int v = face.mIndices[j];
+
+            if (!is_valid(m_localVertices[v])) {
+                m_localVertices[v] = clusterVertices.size();
+                clusterVertices.push_back(v);
+                locked.push_back(m_lockedVertices[v]);
+            }
+        }
+    }
+
+    aiMesh clusterMesh;
+    clusterMesh.mName = m_mesh->mName;
+    clusterMesh.mMaterialIndex = m_mesh->mMaterialIndex;
+
+    unsigned int vc = clusterVertices.size();
+
+    clusterMesh.mNumVertices = vc;
+    clusterMesh.mVertices = new aiVector3D[vc];
+    clusterMesh.mNormals = new aiVector3D[vc];
+
+    for (unsigned int v = 0; v < vc; ++v) {
+        clusterMesh.mVertices[v] = m_mesh->mVertices[clusterVertices[v]];
+        clusterMesh.mNormals[v] = m_mesh->mNormals[clusterVertices[v]];
+    }
+
+    unsigned int fc = cluster.m_faceCount;
+
+    clusterMesh.mNumFaces = fc;
+    clusterMesh.mFaces = new aiFace[fc];
+
+    for (unsigned int f = 0; f < fc; ++f) {
+        const aiFace& face = m_mesh->mFaces[m_faceOrder[cluster.m_firstFace + f]];
+        aiFace& clusterFace = clusterMesh.mFaces[f];
+
+        clusterFace.mNumIndices = 3;
+        clusterFace.mIndices = new unsigned int[3];
+
+        for (unsigned int j = 0; j < 3; ++j) {
+            clusterFace.mIndices[j] = m_localVertices[face.mIndices[j]];
+        }
+    }
+
+    for (unsigned int v : clusterVertices) {
+        m_localVertices[v] = inv_index;
+    }
+
+    // the target is distributed over the clusters in proportion to their size
+    unsigned int target = static_cast<unsigned int>(std::lround(double(fc) * m_targetFaceCount / m_mesh->mNumFaces));
+
+    Mesh mesh(&clusterMesh);
+
+    {
+        MeshDecimator decimator(&mesh, target);
+        decimator.setStrategy(m_strategy);
+        decimator.setPrecision(m_precision);
+        decimator.setSolver(m_solver);
+        decimator.setLockedVertices(std::move(locked));
+
+        connect(&decimator, &MeshDecimator::progressChanged, [this, fc] (float value) {
+            float p = float((m_finishedFaces + double(value) * fc) / m_mesh->mNumFaces);
+            m_progress = p;
+            emit progressChanged(p);
+        });
+        connect(&decimator, &MeshDecimator::error, this, &StreamingDecimator::error, Qt::DirectConnection);
+
+        {
+            QMutexLocker ml(&m_mutex);
+            m_activeDecimator = &decimator;
+        }
+
+        if (!isAborting()) {
+            decimator.start();
+        }
+
+        {
+            QMutexLocker ml(&m_mutex);
+            m_activeDecimator = nullptr;
+        }
+
+        m_stats += decimator.stats();
+    }
+
+    stitch(mesh, clusterVertices);
+}
+
+void StreamingDecimator::stitch(const Mesh &mesh, const std::vector<unsigned int> &clusterVertices)
+{
+    std::vector<mesh_index> vertexMap(mesh.vertexCount());
+
+    for (mesh_index v = 0; v < mesh.vertexCount(); ++v) {
+        unsigned int iv = clusterVertices[mesh.vSource(v)];
+
+        if (!m_lockedVertices[iv]) {
+            vertexMap[v] = m_positions.size();
+            m_positions.push_back(mesh.vPosition(v));
+            m_normals.push_back(mesh.vNormal(v));
+            continue;
+        }
+
+        // locked vertices have not been moved. their imported normal takes all clusters into account
+        if (!is_valid(m_outputVertices[iv])) {
+            m_outputVertices[iv] = m_positions.size();
+            m_positions.push_back(mesh.vPosition(v));
+            m_normals.push_back(reinterpret_cast<const glm::vec3&>(m_mesh->mNormals[iv]));
+        }
+
+        vertexMap[v] = m_outputVertices[iv];
+    }
+
+    for (mesh_index f = 0; f < mesh.faceCount(); ++f) {
+        mesh_index e0 = mesh.fEdge(f), e1 = mesh.eNext(e0), e2 = mesh.eNext(e1);
+
+        m_indices.push_back(vertexMap[mesh.eVertex(e0)]);
+        m_indices.push_back(vertexMap[mesh.eVertex(e1)]);
+        m_indices.push_back(vertexMap[mesh.eVertex(e2)]);
+    }
+}
+
+aiMesh *StreamingDecimator::makeExportMesh() const
+{
+    aiMesh* mesh = new aiMesh();
+
+    mesh->mName = m_mesh->mName;
+    mesh->mMaterialIndex = m_mesh->mMaterialIndex;
+
+    unsigned int vc = vertexCount();
+
+    mesh->mNumVertices = vc;
+
+    mesh->mVertices = new aiVector3D[vc];
+    std::memcpy(mesh->mVertices, m_positions.data(), vc * sizeof(glm::vec3));
+
+    mesh->mNormals = new aiVector3D[vc];
+    std::memcpy(mesh->mNormals, m_normals.data(), vc * sizeof(glm::vec3));
+
+    unsigned int fc = faceCount();
+
+    mesh->mNumFaces = fc;
+    mesh->mFaces = new aiFace[fc];
+
+    for (unsigned int f = 0; f < fc; ++f) {
+        aiFace& face = mesh->mFaces[f];
+
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned int[3];
+
+        face.mIndices[0] = m_indices[f*3 + 0];
+        face.mIndices[1] = m_indices[f*3 + 1];
+        face.mIndices[2] = m_indices[f*3 + 2];
+    }
+
+    return mesh;
+}
+
+void StreamingDecimator::start()
+{
+    m_stats = DecimationStats();
+    m_positions.clear();
+    m_normals.clear();
+    m_indices.clear();
+    m_finishedFaces = 0;
+
+    partition();
+    lockSharedVertices();
+
+    m_localVertices.assign(m_mesh->mNumVertices, inv_index);
+    m_outputVertices.assign(m_mesh->mNumVertices, inv_index);
+
+    // once aborted, the remaining clusters are stitched without being decimated
+    for (const Cluster& cluster : m_clusters) {
+        decimateCluster(cluster);
+        m_finishedFaces += cluster.m_faceCount;
+    }
+
+    // the scratch buffers are as large as the imported mesh
+    std::vector<mesh_index>().swap(m_localVertices);
+    std::vector<mesh_index>().swap(m_outputVertices);
+
+    m_progress = 1.0f;
+    emit progressChanged(1.0f);
+
+    emit statsAvailable(m_stats);
+    emit finished();
+}
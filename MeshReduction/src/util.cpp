@@ -1,72 +1,151 @@
 #include "util.hpp"
 
+#include <QElapsedTimer>
+
+#include <cmath>
+#include <limits>
 #include <algorithm>
-#include <functional>
 
-sym_mat3::sym_mat3()
+double elapsedMs(QElapsedTimer& timer)
 {
-    m_data.fill(0.0f);
+    double ms = timer.nsecsElapsed() * 1e-6;
+    timer.restart();
+    return ms;
 }
 
-sym_mat3::sym_mat3(float m11, float m12, float m13, float m22, float m23, float m33)
-                : m_data({m11, m12, m13, m22, m23, m33}) { }
+template<typename T>
+basic_sym_mat3<T>::basic_sym_mat3()
+{
+    m_data.fill(T(0));
+}
 
-sym_mat3 &sym_mat3::operator+=(const sym_mat3 &other)
+template<typename T>
+basic_sym_mat3<T>::basic_sym_mat3(T m11, T m12, T m13, T m22, T m23, T m33)
+                : m_data({{m11, m12, m13, m22, m23, m33}}) { }
+
+template<typename T>
+basic_sym_mat3<T> &basic_sym_mat3<T>::operator+=(const basic_sym_mat3 &other)
 {
-    std::transform(m_data.begin(), m_data.end(),
-                   other.m_data.begin(),
-                   m_data.begin(),
-                   std::plus<float>());
+    for (std::size_t i = 0; i < m_data.size(); ++i) {
+        m_data[i] += other.m_data[i];
+    }
 
     return *this;
 }
 
-sym_mat3 sym_mat3::operator+(const sym_mat3 &other) const
+template<typename T>
+basic_sym_mat3<T> basic_sym_mat3<T>::operator+(const basic_sym_mat3 &other) const
 {
-    sym_mat3 result(*this);
+    basic_sym_mat3 result(*this);
     return result += other;
 }
 
-sym_mat3 &sym_mat3::operator*=(float factor)
+template<typename T>
+basic_sym_mat3<T> &basic_sym_mat3<T>::operator*=(T factor)
 {
-    std::transform(m_data.begin(), m_data.end(), m_data.begin(),
-                   std::bind(std::multiplies<float>(), std::placeholders::_1, factor));
+    for (T& d : m_data) {
+        d *= factor;
+    }
 
     return *this;
 }
 
-sym_mat3 sym_mat3::operator*(float factor) const
+template<typename T>
+basic_sym_mat3<T> basic_sym_mat3<T>::operator*(T factor) const
 {
-    sym_mat3 result(*this);
+    basic_sym_mat3 result(*this);
     return result *= factor;
 }
 
-glm::vec3 sym_mat3::operator*(const glm::vec3 &v) const
+template<typename T>
+glm::tvec3<T> basic_sym_mat3<T>::operator*(const glm::tvec3<T> &v) const
 {
-    return glm::vec3(m_data[0] * v.x + m_data[1] * v.y + m_data[2] * v.z,
-                     m_data[1] * v.x + m_data[3] * v.y + m_data[4] * v.z,
+    return glm::tvec3<T>(m_data[0] * v.x + m_data[1] * v.y + m_data[2] * v.z,
+                         m_data[1] * v.x + m_data[3] * v.y + m_data[4] * v.z,
             m_data[2] * v.x + m_data[4] * v.y + m_data[5] * v.z);
 }
 
-sym_mat3::operator glm::mat3() const
+template<typename T>
+basic_sym_mat3<T>::operator glm::tmat3x3<T>() const
 {
-    return glm::mat3(m_data[0], m_data[1], m_data[2],
-                     m_data[1], m_data[3], m_data[4],
-                     m_data[2], m_data[4], m_data[5]);
+    return glm::tmat3x3<T>(m_data[0], m_data[1], m_data[2],
+                           m_data[1], m_data[3], m_data[4],
+                           m_data[2], m_data[4], m_data[5]);
 }
 
-Quadric::Quadric() : m_A(), m_b(0.0f, 0.0f, 0.0f), m_c(0.0f) { }
+template<typename T>
+void symmetricEigen(const basic_sym_mat3<T> &A, T *eigenvalues, glm::tvec3<T> *eigenvectors)
+{
+    const std::array<T, 6>& d = A.m_data;
+
+    T a[3][3] = { { d[0], d[1], d[2] }, { d[1], d[3], d[4] }, { d[2], d[4], d[5] } };
+    T v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+    const T eps = std::numeric_limits<T>::epsilon();
+
+    for (int sweep = 0; sweep < 32; ++sweep) {
+        T off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        T diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+
+        if (off <= eps * eps * diag || off == T(0)) // off-diagonal elements are negligible
+            break;
+
+        for (int p = 0; p < 2; ++p) {
+            for (int q = p + 1; q < 3; ++q) {
+                if (a[p][q] == T(0))
+                    continue;
+
+                // rotation which eliminates a[p][q]
+                T theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                T t = T(1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                if (theta < 0)
+                    t = -t;
+
+                T c = T(1) / std::sqrt(t * t + 1), s = t * c;
+
+                for (int k = 0; k < 3; ++k) {
+                    T akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    T apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    T vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        eigenvalues[i] = a[i][i];
+        eigenvectors[i] = glm::tvec3<T>(v[0][i], v[1][i], v[2][i]);
+    }
+}
 
-Quadric::Quadric(const glm::vec3& n, float d) :
+template<typename T>
+BasicQuadric<T>::BasicQuadric() : m_A(), m_b(T(0), T(0), T(0)), m_c(T(0)) { }
+
+template<typename T>
+BasicQuadric<T>::BasicQuadric(const vec_type& n, T d) :
     m_A(n.x * n.x, n.x * n.y, n.x * n.z,
                    n.y * n.y, n.y * n.z,
                               n.z * n.z),
     m_b(d * n),
     m_c(d * d) { }
 
-Quadric::Quadric(const glm::vec3 &n, const glm::vec3 &p) : Quadric(n, -glm::dot(n, p)) { }
+template<typename T>
+BasicQuadric<T>::BasicQuadric(const vec_type &n, const vec_type &p) : BasicQuadric(n, -glm::dot(n, p)) { }
 
-Quadric &Quadric::operator+=(const Quadric &other)
+template<typename T>
+BasicQuadric<T> &BasicQuadric<T>::operator+=(const BasicQuadric &other)
 {
     m_A += other.m_A;
     m_b += other.m_b;
@@ -75,13 +154,15 @@ Quadric &Quadric::operator+=(const Quadric &other)
     return *this;
 }
 
-Quadric Quadric::operator+(const Quadric &other) const
+template<typename T>
+BasicQuadric<T> BasicQuadric<T>::operator+(const BasicQuadric &other) const
 {
-    Quadric result(*this);
+    BasicQuadric result(*this);
     return result += other;
 }
 
-Quadric &Quadric::operator*=(float factor)
+template<typename T>
+BasicQuadric<T> &BasicQuadric<T>::operator*=(T factor)
 {
     m_A *= factor;
     m_b *= factor;
@@ -90,30 +171,86 @@ Quadric &Quadric::operator*=(float factor)
     return *this;
 }
 
-Quadric Quadric::operator*(float factor) const
+template<typename T>
+BasicQuadric<T> BasicQuadric<T>::operator*(T factor) const
 {
-    Quadric result(*this);
+    BasicQuadric result(*this);
     return result *= factor;
 }
 
-float Quadric::operator()(const glm::vec3 &v) const
+// note: quadric_batch uses the exact same order of operations in all of its code paths
+
+template<typename T>
+T BasicQuadric<T>::operator()(const vec_type &v) const
 {
-    return glm::dot(v, m_A * v) + 2.0f * glm::dot(m_b, v) + m_c;
+    const std::array<T, 6>& a = m_A.m_data;
+
+    T ax = a[0] * v.x + a[1] * v.y + a[2] * v.z;
+    T ay = a[1] * v.x + a[3] * v.y + a[4] * v.z;
+    T az = a[2] * v.x + a[4] * v.y + a[5] * v.z;
+    T bv = m_b.x * v.x + m_b.y * v.y + m_b.z * v.z;
+
+    return v.x * ax + v.y * ay + v.z * az + T(2) * bv + m_c;
 }
 
-bool Quadric::optimum(glm::vec3 *v, float *cost) const
+template<typename T>
+bool BasicQuadric<T>::optimum(vec_type *v, T *cost) const
 {
-    glm::mat3 A(m_A);
-    float det = glm::determinant(A);
+    const std::array<T, 6>& a = m_A.m_data;
 
-    if (glm::abs(det) < 0.001f) // matrix not invertible or poorly conditioned
+    // cofactors of the symmetric matrix A (the adjugate is symmetric as well)
+    T c11 = a[3] * a[5] - a[4] * a[4];
+    T c12 = a[2] * a[4] - a[1] * a[5];
+    T c13 = a[1] * a[4] - a[2] * a[3];
+    T c22 = a[0] * a[5] - a[2] * a[2];
+    T c23 = a[1] * a[2] - a[0] * a[4];
+    T c33 = a[0] * a[3] - a[1] * a[1];
+
+    T det = a[0] * c11 + a[1] * c12 + a[2] * c13;
+
+    if (std::abs(det) < T(quadric_min_det)) // matrix not invertible or poorly conditioned
         return false;
 
-    glm::mat3 iA = glm::inverse(A);
-    glm::vec3 tmp = iA * m_b;
-    *v = -tmp;
-    *cost = -glm::dot(m_b, tmp) + m_c;
+    // v = -inverse(A) * b
+    T s = T(-1) / det;
+    v->x = (c11 * m_b.x + c12 * m_b.y + c13 * m_b.z) * s;
+    v->y = (c12 * m_b.x + c22 * m_b.y + c23 * m_b.z) * s;
+    v->z = (c13 * m_b.x + c23 * m_b.y + c33 * m_b.z) * s;
+
+    *cost = m_b.x * v->x + m_b.y * v->y + m_b.z * v->z + m_c;
 
     return true;
 }
 
+template<typename T>
+void BasicQuadric<T>::optimumPseudoInverse(const vec_type &center, vec_type *v, T *cost) const
+{
+    T lambda[3];
+    vec_type e[3];
+    symmetricEigen(m_A, lambda, e);
+
+    T maxLambda = std::max(std::abs(lambda[0]), std::max(std::abs(lambda[1]), std::abs(lambda[2])));
+    T tolerance = maxLambda * T(quadric_rel_tolerance);
+
+    // solve A * (x - center) = -(A * center + b) in the subspace spanned by the significant eigenvectors
+    vec_type r = -(m_A * center + m_b);
+    vec_type x = center;
+
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(lambda[i]) > tolerance && lambda[i] != T(0)) {
+            x += e[i] * (glm::dot(e[i], r) / lambda[i]);
+        }
+    }
+
+    *v = x;
+    *cost = (*this)(x);
+}
+
+template struct basic_sym_mat3<float>;
+template struct basic_sym_mat3<double>;
+
+template void symmetricEigen(const basic_sym_mat3<float>&, float*, glm::tvec3<float>*);
+template void symmetricEigen(const basic_sym_mat3<double>&, double*, glm::tvec3<double>*);
+
+template struct BasicQuadric<float>;
+template struct BasicQuadric<double>;
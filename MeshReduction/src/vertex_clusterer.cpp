@@ -0,0 +1,315 @@
+#include "vertex_clusterer.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "memory_usage.hpp"
+#include "util.hpp"
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <algorithm>
+#include <unordered_set>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+// the grid is limited to 2^30 cells, so that cell indices fit into 32 bits
+#define MAX_RESOLUTION 1024
+
+namespace
+{
+
+/*!
+ * \brief sorts indices by their (32 bit) keys with a least significant digit radix sort. the sort is stable
+ */
+void radixSort(std::vector<unsigned int>& indices, const std::vector<unsigned int>& keys, unsigned int maxKey)
+{
+    std::vector<unsigned int> buffer(indices.size());
+
+    for (unsigned int shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += 8) {
+        std::size_t counts[257] = { 0 };
+
+        for (unsigned int i : indices) {
+            ++counts[((keys[i] >> shift) & 0xff) + 1];
+        }
+
+        for (unsigned int d = 0; d < 256; ++d) {
+            counts[d + 1] += counts[d];
+        }
+
+        for (unsigned int i : indices) {
+            buffer[counts[(keys[i] >> shift) & 0xff]++] = i;
+        }
+
+        indices.swap(buffer);
+    }
+}
+
+}
+
+VertexClusterer::VertexClusterer(Mesh *mesh, unsigned int resolution) :
+    m_mesh(mesh), m_resolution(std::max(1u, std::min<unsigned int>(resolution, MAX_RESOLUTION))), m_abort(false), m_progress(0.0f), m_cellSize(0.0f),
+    m_gridSize{1, 1, 1}
+{ }
+
+VertexClusterer::~VertexClusterer() { }
+
+float VertexClusterer::progress() const
+{
+    return m_progress.load();
+}
+
+void VertexClusterer::setProgress(float value)
+{
+    m_progress = value;
+    emit progressChanged(value);
+}
+
+bool VertexClusterer::isAborting() const
+{
+    return m_abort.load();
+}
+
+void VertexClusterer::abort()
+{
+    m_abort = true;
+}
+
+void VertexClusterer::initGrid()
+{
+    unsigned int vc = m_mesh->vertexCount();
+
+    glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+    QMutex mutex;
+
+    parallel_for(vc, [&] (std::size_t begin, std::size_t end) {
+        glm::vec3 l(std::numeric_limits<float>::max()), u(-std::numeric_limits<float>::max());
+
+        for (mesh_index v = begin; v < end; ++v) {
+            l = glm::min(l, m_mesh->vPosition(v));
+            u = glm::max(u, m_mesh->vPosition(v));
+        }
+
+        QMutexLocker ml(&mutex);
+        lower = glm::min(lower, l);
+        upper = glm::max(upper, u);
+    });
+
+    glm::vec3 extent = glm::max(upper - lower, glm::vec3(0.0f));
+    float longest = std::max(extent.x, std::max(extent.y, extent.z));
+
+    // cells are cubes, the longest side of the bounding box is divided into m_resolution cells
+    m_gridOrigin = lower;
+    m_cellSize = longest > 0.0f ? longest / m_resolution : 1.0f;
+
+    for (int i = 0; i < 3; ++i) {
+        m_gridSize[i] = std::max(1u, std::min(m_resolution, static_cast<unsigned int>(std::ceil(extent[i] / m_cellSize))));
+    }
+
+    m_vertexCells.resize(vc);
+
+    parallel_for(vc, [this] (std::size_t begin, std::size_t end) {
+        for (mesh_index v = begin; v < end; ++v) {
+            glm::vec3 p = (m_mesh->vPosition(v) - m_gridOrigin) / m_cellSize;
+            unsigned int c[3];
+
+            for (int i = 0; i < 3; ++i) {
+                c[i] = std::min(m_gridSize[i] - 1, static_cast<unsigned int>(std::max(0.0f, p[i])));
+            }
+
+            m_vertexCells[v] = c[0] + m_gridSize[0] * (c[1] + m_gridSize[1] * c[2]);
+        }
+    });
+}
+
+void VertexClusterer::assignClusters()
+{
+    unsigned int vc = m_mesh->vertexCount();
+
+    // sort the vertices by cell. every run of vertices with the same cell becomes a cluster
+    m_clusterMembers.resize(vc);
+    for (mesh_index v = 0; v < vc; ++v) {
+        m_clusterMembers[v] = v;
+    }
+
+    radixSort(m_clusterMembers, m_vertexCells, m_gridSize[0] * m_gridSize[1] * m_gridSize[2] - 1);
+
+    m_clusterOffsets.clear();
+    m_vertexClusters.resize(vc);
+
+    for (mesh_index i = 0; i < vc; ++i) {
+        mesh_index v = m_clusterMembers[i];
+
+        if (i == 0 || m_vertexCells[v] != m_vertexCells[m_clusterMembers[i - 1]])
+            m_clusterOffsets.push_back(i);
+
+        m_vertexClusters[v] = m_clusterOffsets.size() - 1;
+    }
+
+    m_clusterOffsets.push_back(vc);
+}
+
+void VertexClusterer::placeRepresentatives()
+{
+    std::size_t clusterCount = m_clusterOffsets.size() - 1;
+    m_clusterPositions.resize(clusterCount);
+
+    parallel_for(clusterCount, [this] (std::size_t begin, std::size_t end) {
+        for (std::size_t c = begin; c < end; ++c) {
+            QuadricD Q;
+            glm::dvec3 mean(0.0);
+
+            for (mesh_index i = m_clusterOffsets[c]; i < m_clusterOffsets[c + 1]; ++i) {
+                mesh_index v = m_clusterMembers[i];
+                glm::dvec3 vp(m_mesh->vPosition(v));
+                mean += vp;
+
+                // plane of every face around the vertex. a face is added once per corner in the cluster
+                for (mesh_index e : m_mesh->vEdgeFan(v)) {
+                    if (m_mesh->eIsBoundary(e))
+                        continue;
+
+                    mesh_index f = m_mesh->eFace(e);
+
+                    if (m_mesh->fArea(f) > 0.0f)
+                        Q += QuadricD(glm::dvec3(m_mesh->fNormal(f)), vp);
+                }
+            }
+
+            mean /= double(m_clusterOffsets[c + 1] - m_clusterOffsets[c]);
+
+            // the optimum is only used if it lies within the cell, otherwise the cluster might form a spike
+            glm::dvec3 optimum;
+            double cost;
+            glm::vec3 position(mean);
+
+            if (Q.optimum(&optimum, &cost)) {
+                glm::vec3 cell = glm::floor((glm::vec3(optimum) - m_gridOrigin) / m_cellSize);
+                unsigned int id = m_vertexCells[m_clusterMembers[m_clusterOffsets[c]]];
+                glm::vec3 expected(id % m_gridSize[0], (id / m_gridSize[0]) % m_gridSize[1], id / (m_gridSize[0] * m_gridSize[1]));
+
+                if (cell == expected)
+                    position = glm::vec3(optimum);
+            }
+
+            m_clusterPositions[c] = position;
+        }
+    });
+}
+
+void VertexClusterer::rebuildMesh()
+{
+    unsigned int fc = m_mesh->faceCount();
+
+    // faces which keep three distinct corners
+    std::vector<unsigned char> kept(fc);
+
+    parallel_for(fc, [this, &kept] (std::size_t begin, std::size_t end) {
+        for (mesh_index f = begin; f < end; ++f) {
+            mesh_index e0 = m_mesh->fEdge(f), e1 = m_mesh->eNext(e0), e2 = m_mesh->eNext(e1);
+            mesh_index c0 = m_vertexClusters[m_mesh->eVertex(e0)];
+            mesh_index c1 = m_vertexClusters[m_mesh->eVertex(e1)];
+            mesh_index c2 = m_vertexClusters[m_mesh->eVertex(e2)];
+
+            kept[f] = (c0 != c1 && c1 != c2 && c2 != c0) ? 1 : 0;
+        }
+    });
+
+    // every directed edge may only be used once, otherwise the result would contain non-manifold edges or
+    // inconsistently oriented faces, which the halfedge structure cannot represent. the first face wins
+    // directed edges are packed into a single 64 bit key (from cluster in the upper half)
+    std::unordered_set<std::uint64_t> usedEdges;
+    auto edgeKey = [] (mesh_index from, mesh_index to) {
+        return (std::uint64_t(from) << 32) | to;
+    };
+    usedEdges.reserve(std::count(kept.begin(), kept.end(), 1) * 3);
+    std::vector<mesh_index> newVertices(m_clusterPositions.size(), inv_index);
+
+    std::vector<glm::vec3> positions;
+    std::vector<mesh_index> sources;
+    std::vector<unsigned int> indices;
+
+    for (mesh_index f = 0; f < fc; ++f) {
+        if (!kept[f])
+            continue;
+
+        mesh_index e0 = m_mesh->fEdge(f), e1 = m_mesh->eNext(e0), e2 = m_mesh->eNext(e1);
+        mesh_index corners[3] = { m_mesh->eVertex(e0), m_mesh->eVertex(e1), m_mesh->eVertex(e2) };
+        mesh_index c[3];
+
+        for (int i = 0; i < 3; ++i) {
+            c[i] = m_vertexClusters[corners[i]];
+        }
+
+        std::uint64_t keys[3] = { edgeKey(c[0], c[1]), edgeKey(c[1], c[2]), edgeKey(c[2], c[0]) };
+
+        if (usedEdges.count(keys[0]) || usedEdges.count(keys[1]) || usedEdges.count(keys[2]))
+            continue;
+
+        usedEdges.insert(keys, keys + 3);
+
+        for (int i = 0; i < 3; ++i) {
+            if (!is_valid(newVertices[c[i]])) {
+                newVertices[c[i]] = positions.size();
+                positions.push_back(m_clusterPositions[c[i]]);
+                sources.push_back(m_mesh->vSource(m_clusterMembers[m_clusterOffsets[c[i]]]));
+            }
+
+            indices.push_back(newVertices[c[i]]);
+        }
+    }
+
+    std::vector<glm::vec3> normals(positions.size());
+    m_mesh->assignTriangles(std::move(positions), std::move(normals), std::move(sources), indices);
+}
+
+void VertexClusterer::start()
+{
+    {
+        QMutexLocker ml(m_mesh->mutex());
+
+        if (m_mesh->isDirty()) {
+            m_mesh->reset();
+        }
+
+        m_stats = DecimationStats();
+        m_stats.m_facesBefore = m_mesh->faceCount();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        initGrid();
+        assignClusters();
+
+        setProgress(0.3f);
+
+        if (!isAborting()) {
+            placeRepresentatives();
+            m_stats.m_computeQuadricsMs = elapsedMs(timer);
+
+            setProgress(0.6f);
+        }
+
+        if (!isAborting()) {
+            rebuildMesh();
+            m_stats.m_cleanupMs = elapsedMs(timer);
+
+            m_mesh->recomputeNormals();
+            m_stats.m_normalsMs = elapsedMs(timer);
+        }
+
+        m_stats.m_facesAfter = m_stats.m_targetFaces = m_mesh->faceCount();
+        m_stats.m_peakMemoryBytes = peakMemoryUsage();
+
+        // the scratch buffers are as large as the original mesh
+        std::vector<unsigned int>().swap(m_vertexCells);
+        std::vector<mesh_index>().swap(m_vertexClusters);
+        std::vector<mesh_index>().swap(m_clusterMembers);
+    }
+
+    setProgress(1.0f);
+
+    emit statsAvailable(m_stats);
+
+    emit finished();
+}